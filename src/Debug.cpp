@@ -1,4 +1,5 @@
 #include "Debug.h"
+#include "Commands.h"
 #include "Gui.h"
 #include "pxr/base/trace/reporter.h"
 #include "pxr/base/trace/trace.h"
@@ -84,6 +85,12 @@ void DrawDebugUI() {
     if (current_item == 0) {
         ImGui::BeginChild("##Timing");
         ImGui::Text("ImGui: %.3f ms/frame  (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        const float megabyte = 1024.f * 1024.f;
+        if (GetUndoMemoryBudget()) {
+            ImGui::Text("Undo history: %.1f MB / %.0f MB", GetUndoMemorySize() / megabyte, GetUndoMemoryBudget() / megabyte);
+        } else {
+            ImGui::Text("Undo history: %.1f MB", GetUndoMemorySize() / megabyte);
+        }
         ImGui::EndChild();
     } else if (current_item == 1) {
         ImGui::BeginChild("##DebugCodes");
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <array>
 #include <utility>
 #include <pxr/imaging/garch/glApi.h>
@@ -39,6 +40,7 @@
 #include "ManipulatorToolbox.h"
 #include "HydraBrowser.h"
 #include "Preferences.h"
+#include "EditJournal.h"
 namespace clk = std::chrono;
 
 // There is a bug in the Undo/Redo when reloading certain layers, here is the post
@@ -66,6 +68,7 @@ namespace clk = std::chrono;
 #define Viewport4WindowTitle "Viewport4"
 #define StatusBarWindowTitle "Status bar"
 #define LauncherBarWindowTitle "Launcher bar"
+#define LayerSavesWindowTitle "Layer saves"
 
 // Used only in the editor, so no point adding them to ImGuiHelpers yet
 inline bool BelongToSameDockTab(ImGuiWindow *w1, ImGuiWindow *w2) {
@@ -144,6 +147,45 @@ struct CloseEditorModalDialog : public ModalDialog {
 };
 
 
+/// Modal dialog listing the layers having unsaved edits in the journal of a previous session
+struct RecoverEditsModalDialog : public ModalDialog {
+    RecoverEditsModalDialog(Editor &editor, std::vector<std::string> layerIdentifiers)
+        : editor(editor), layerIdentifiers(layerIdentifiers), recoverLayers(layerIdentifiers.size(), 1) {}
+
+    void Draw() override {
+        ImGui::Text("usdtweak did not close properly, unsaved edits were found on the following layers:");
+        for (size_t i = 0; i < layerIdentifiers.size(); ++i) {
+            bool recoverLayer = recoverLayers[i];
+            if (ImGui::Checkbox(layerIdentifiers[i].c_str(), &recoverLayer)) {
+                recoverLayers[i] = recoverLayer;
+            }
+        }
+        ImGui::Text("The edits are replayed on the selected layers, the others are discarded.");
+        if (ImGui::Button("  Recover  ")) {
+            for (size_t i = 0; i < layerIdentifiers.size(); ++i) {
+                if (recoverLayers[i]) {
+                    SdfLayerRefPtr layer = EditJournal::GetInstance().Recover(layerIdentifiers[i]);
+                    editor.SetCurrentLayer(layer, true);
+                } else {
+                    EditJournal::GetInstance().Discard(layerIdentifiers[i]);
+                }
+            }
+            CloseModal();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("  Discard all  ")) {
+            for (const auto &layerIdentifier : layerIdentifiers) {
+                EditJournal::GetInstance().Discard(layerIdentifier);
+            }
+            CloseModal();
+        }
+    }
+    const char *DialogId() const override { return "Recover unsaved edits"; }
+    Editor &editor;
+    std::vector<std::string> layerIdentifiers;
+    std::vector<char> recoverLayers;
+};
+
 void Editor::RequestShutdown() {
     if (!_isShutdown) {
         ExecuteAfterDraw<EditorShutdown>();
@@ -214,7 +256,10 @@ struct OpenUsdFileModalDialog : public ModalDialog {
         ImGui::Checkbox("Open as stage", &openAsStage);
         if (openAsStage) {
             ImGui::SameLine();
-            ImGui::Checkbox("Load payloads", &openLoaded);
+            ImGui::SetNextItemWidth(ImGui::GetFontSize() * 22);
+            ImGui::Combo("Payloads", &payloadLoading,
+                         "Load all\0Load none\0Load progressively, closest to the camera first\0"
+                         "Load progressively, outliner rows first\0");
         }
         if (!FilePathExists()) {
             ImGui::Text("Not found: ");
@@ -225,7 +270,7 @@ struct OpenUsdFileModalDialog : public ModalDialog {
         DrawModalButtonsOkCancel([&]() {
             if (!filePath.empty() && FilePathExists()) {
                 if (openAsStage) {
-                    editor.OpenStage(filePath, openLoaded);
+                    editor.OpenStage(filePath, static_cast<PayloadLoading>(payloadLoading));
                 } else {
                     editor.FindOrOpenLayer(filePath);
                 }
@@ -236,9 +281,84 @@ struct OpenUsdFileModalDialog : public ModalDialog {
     const char *DialogId() const override { return "Open layer"; }
     Editor &editor;
     bool openAsStage = true;
-    bool openLoaded = true;
+    int payloadLoading = static_cast<int>(PayloadLoading::All);
 };
 
+/// Progress of the stages opened in the background. It is not a ModalDialog as it must close itself when the stage is
+/// ready, it waits for the other modal dialogs to be closed
+static void DrawStageOpenerProgress(StageOpener &stageOpener) {
+    static constexpr const char *popupId = "Opening stage";
+    const bool isOpening = stageOpener.IsOpening();
+    if (isOpening && !ImGui::IsPopupOpen(popupId) && !ImGui::IsPopupOpen("", ImGuiPopupFlags_AnyPopup)) {
+        ImGui::OpenPopup(popupId);
+    }
+    if (ImGui::BeginPopupModal(popupId, nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        if (!isOpening) {
+            ImGui::CloseCurrentPopup();
+        }
+        const ImVec2 progressBarSize(ImGui::GetFontSize() * 25, 0.f);
+        ImGui::Text("%s", stageOpener.GetPath().c_str());
+        ImGui::Text("Layers read: %zu", stageOpener.GetLayersRead());
+        const size_t payloadCount = stageOpener.GetPayloadCount();
+        if (payloadCount) {
+            const size_t payloadsLoaded = stageOpener.GetPayloadsLoaded();
+            ImGui::Text("Payloads loaded: %zu / %zu", payloadsLoaded, payloadCount);
+            ImGui::ProgressBar(static_cast<float>(payloadsLoaded) / static_cast<float>(payloadCount), progressBarSize);
+        } else {
+            ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), progressBarSize, "Composing");
+        }
+        if (stageOpener.GetWaitingCount()) {
+            ImGui::Text("%zu more stages waiting", stageOpener.GetWaitingCount());
+        }
+        if (stageOpener.IsCancelled()) {
+            ImGui::Text("Cancelling, waiting for the layers being read");
+        } else if (ImGui::Button("  Cancel  ")) {
+            stageOpener.Cancel();
+        }
+        ImGui::EndPopup();
+    }
+}
+
+/// Progress and errors of the layers saved in the background, the window stays opened until the finished saves are
+/// cleared
+static void DrawLayerSaves(LayerSaver &layerSaver) {
+    if (layerSaver.GetSaves().empty()) {
+        return;
+    }
+    ImGui::Begin(LayerSavesWindowTitle, nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    const ImVec2 progressBarSize(ImGui::GetFontSize() * 12, 0.f);
+    if (ImGui::BeginTable("##LayerSaves", 3, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+        const auto now = std::chrono::steady_clock::now();
+        char overlay[64];
+        for (const LayerSaver::Save &save : layerSaver.GetSaves()) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", save.path.c_str());
+            ImGui::TableSetColumnIndex(1);
+            if (save.status == LayerSaver::SaveStatus::Waiting) {
+                ImGui::ProgressBar(0.f, progressBarSize, "Waiting");
+            } else if (save.status == LayerSaver::SaveStatus::Writing) {
+                snprintf(overlay, sizeof(overlay), "Writing %.1fs", std::chrono::duration<float>(now - save.startTime).count());
+                ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), progressBarSize, overlay);
+            } else if (save.status == LayerSaver::SaveStatus::Saved) {
+                snprintf(overlay, sizeof(overlay), "Saved in %.1fs", std::chrono::duration<float>(save.duration).count());
+                ImGui::ProgressBar(1.f, progressBarSize, overlay);
+            } else {
+                ImGui::TextColored(ImVec4(1.0f, 0.1f, 0.1f, 1.0f), "Failed");
+            }
+            ImGui::TableSetColumnIndex(2);
+            if (save.status == LayerSaver::SaveStatus::Failed) {
+                ImGui::TextUnformatted(save.errors.c_str());
+            }
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Clear finished saves")) {
+        layerSaver.ClearFinished();
+    }
+    ImGui::End();
+}
+
 struct SaveLayerAsDialog : public ModalDialog {
 
     SaveLayerAsDialog(Editor &editor, SdfLayerRefPtr layer) : editor(editor), _layer(layer) {};
@@ -358,17 +478,18 @@ void Editor::DropCallback(GLFWwindow *window, int count, const char **paths) {
     void *userPointer = glfwGetWindowUserPointer(window);
     if (userPointer) {
         Editor *editor = static_cast<Editor *>(userPointer);
-        // TODO: Create a task, add a callback
         if (editor && count) {
+            std::vector<std::string> layerPaths;
             for (int i = 0; i < count; ++i) {
                 // make a drop event ?
                 if (ArchGetFileLength(paths[i]) == 0) {
                     // if the file is empty, this is considered a new file
                     editor->CreateStage(std::string(paths[i]));
                 } else {
-                    editor->FindOrOpenLayer(std::string(paths[i]));
+                    layerPaths.emplace_back(paths[i]);
                 }
             }
+            editor->FindOrOpenLayers(layerPaths);
         }
     }
 }
@@ -394,14 +515,31 @@ Editor::Editor() : _viewport1(UsdStageRefPtr(), _selection),
 _viewport2(UsdStageRefPtr(), _selection),
 _viewport3(UsdStageRefPtr(), _selection),
 _viewport4(UsdStageRefPtr(), _selection),
-_layerHistoryPointer(0) {
+_layerHistoryPointer(0),
+_primNameIndex(_stageMutex),
+_primSearch(_stageMutex),
+_primFilter(_stageMutex),
+_layerFilter(_stageMutex),
+_stageOpener(_stageMutex),
+_payloadLoader(_stageMutex) {
     ExecuteAfterDraw<EditorSetDataPointer>(this); // This is specialized to execute here, not after the draw
     LoadSettings();
+    SetUndoMemoryBudget(_settings._undoMemoryBudget);
+    EditJournal::GetInstance().SetDirectory(ResourcesLoader::GetJournalDirectory());
+    SetEditJournalEnabled(_settings._enableEditJournal);
+    if (IsEditJournalEnabled()) {
+        const std::vector<std::string> recoverableLayers = EditJournal::GetInstance().GetRecoverableLayers();
+        if (!recoverableLayers.empty()) {
+            DrawModalDialog<RecoverEditsModalDialog>(*this, recoverableLayers);
+        }
+    }
     SetFileBrowserDirectory(_settings._lastFileBrowserDirectory);
     Blueprints::GetInstance().SetBlueprintsLocations(_settings._blueprintLocations);
 }
 
 Editor::~Editor(){
+    // Closing normally, the journals are not needed anymore
+    EditJournal::GetInstance().Shutdown();
     _settings._lastFileBrowserDirectory = GetFileBrowserDirectory();
     SaveSettings();
 }
@@ -434,6 +572,11 @@ void Editor::SetCurrentStage(UsdStageRefPtr stage) {
         _viewport2.SetCurrentStage(stage);
         _viewport3.SetCurrentStage(stage);
         _viewport4.SetCurrentStage(stage);
+        _primNameIndex.SetStage(stage);
+        _primSearch.Cancel();
+        _primSearch.Clear();
+        _primFilter.Cancel();
+        _primFilter.Clear();
     }
 }
 
@@ -455,6 +598,10 @@ void Editor::SetCurrentLayer(SdfLayerRefPtr layer, bool showContentBrowser) {
     if (showContentBrowser) {
         _settings._showContentBrowser = true;
     }
+    // The layers keep their selection, a layer shown for the first time has its root selected
+    if (_selection.IsSelectionEmpty(layer)) {
+        _selection.SetSelected(layer, SdfPath::AbsoluteRootPath());
+    }
 }
 
 void Editor::SetCurrentEditTarget(SdfLayerHandle layer) {
@@ -490,10 +637,42 @@ void Editor::FindOrOpenLayer(const std::string &path) {
     SetCurrentLayer(newLayer, true);
 }
 
+void Editor::FindOrOpenLayers(const std::vector<std::string> &paths) {
+    if (!paths.empty()) {
+        _layerOpener.Start(paths);
+    }
+}
+
+// The layers are kept opened by the layer history, the last one becomes the current layer
+void Editor::UpdateOpenedLayers() {
+    SdfLayerRefPtrVector layers;
+    if (_layerOpener.Update(layers)) {
+        for (const auto &layer : layers) {
+            SetCurrentLayer(layer, true);
+        }
+    }
+}
+
 //
-void Editor::OpenStage(const std::string &path, bool openLoaded) {
-    auto newStage = UsdStage::Open(path, openLoaded ? UsdStage::LoadAll : UsdStage::LoadNone); // TODO: as an option
+void Editor::OpenStage(const std::string &path, PayloadLoading payloadLoading) { _stageOpener.Start(path, payloadLoading); }
+
+void Editor::OpenStageSubset(const UsdStageRefPtr &stage, const SdfPathVector &paths) {
+    if (stage) {
+        _stageOpener.Start(stage->GetRootLayer(), stage->GetSessionLayer(), stage->GetPathResolverContext(),
+                           UsdStagePopulationMask(paths), stage->GetLoadSet());
+    }
+}
+
+void Editor::UpdateOpenedStages() {
+    std::string path;
+    PayloadLoading payloadLoading = PayloadLoading::All;
+    auto newStage = _stageOpener.Update(path, payloadLoading);
     if (newStage) {
+        if (payloadLoading == PayloadLoading::ClosestToCameraFirst) {
+            _payloadLoader.Start(newStage, PayloadOrder::ClosestToCamera);
+        } else if (payloadLoading == PayloadLoading::OutlinerRowsFirst) {
+            _payloadLoader.Start(newStage, PayloadOrder::OutlinerRows);
+        }
         GetStageCache().Insert(newStage);
         SetCurrentStage(newStage);
         _settings._showContentBrowser = true;
@@ -515,6 +694,8 @@ void Editor::SaveLayerAs(SdfLayerRefPtr layer, const std::string &path) {
     }
 }
 
+void Editor::SaveLayer(SdfLayerRefPtr layer) { _layerSaver.Start(layer); }
+
 void Editor::CreateStage(const std::string &path) {
     auto usdaFormat = SdfFileFormat::FindByExtension("usda");
     auto layer = SdfLayer::New(usdaFormat, path);
@@ -653,6 +834,16 @@ void Editor::SetStagePathSelection(const SdfPath &primPath) {
     BringWindowToTabFront(UsdPrimPropertiesWindowTitle);
 }
 
+void Editor::SetStagePathsSelection(const SdfPathVector &primPaths) {
+    _selection.SetSelected(GetCurrentStage(), primPaths);
+    BringWindowToTabFront(UsdPrimPropertiesWindowTitle);
+}
+
+void Editor::AddStagePathsSelection(const SdfPathVector &primPaths) {
+    _selection.AddSelected(GetCurrentStage(), primPaths);
+    BringWindowToTabFront(UsdPrimPropertiesWindowTitle);
+}
+
 static void DrawOpenedStages() {
    // ScopedStyleColor defaultStyle(DefaultColorStyle);
     const UsdStageCache &stageCache = UsdUtilsStageCache::Get();
@@ -713,7 +904,7 @@ void Editor::DrawMainMenuBar() {
             ImGui::Separator();
             const bool hasLayer = GetCurrentLayer() != SdfLayerRefPtr();
             if (ImGui::MenuItem(ICON_FA_SAVE " Save layer", "CTRL+S", false, hasLayer)) {
-                GetCurrentLayer()->Save(true);
+                ExecuteAfterDraw<EditorSaveLayer>(GetCurrentLayer());
             }
             if (ImGui::MenuItem(ICON_FA_SAVE " Save current layer as", "CTRL+F", false, hasLayer)) {
                 ExecuteAfterDraw<EditorSaveLayerAs>(GetCurrentLayer());
@@ -824,7 +1015,44 @@ float Editor::GetScaleUI() const {
     return  _settings._uiScale;
 }
 
+void Editor::SetUndoMemoryBudget(int megabytes) {
+    _settings._undoMemoryBudget = std::max(megabytes, 0);
+    ::SetUndoMemoryBudget(static_cast<size_t>(_settings._undoMemoryBudget) * 1024 * 1024);
+}
+
+int Editor::GetUndoMemoryBudget() const {
+    return _settings._undoMemoryBudget;
+}
+
+void Editor::SetEditJournalEnabled(bool enabled) {
+    _settings._enableEditJournal = enabled;
+    EditJournal::GetInstance().SetEnabled(enabled);
+}
+
+bool Editor::IsEditJournalEnabled() const {
+    return EditJournal::GetInstance().IsEnabled();
+}
+
 void Editor::Draw() {
+    // Forget the journals of the layers saved during the last frame
+    EditJournal::GetInstance().Update();
+
+    // Apply the changes of the last frame to the prim name index
+    _primNameIndex.Update();
+    _primSearch.Update();
+    _primFilter.Update();
+    _layerFilter.Update();
+
+    // Make current the stage opened in the background when it is ready
+    UpdateOpenedStages();
+    UpdateOpenedLayers();
+
+    // Mark the layers written in the background as saved
+    _layerSaver.Update();
+
+    // Load the next payloads of the current stage, the loading waits while another stage is current
+    _payloadLoader.Update(GetCurrentStage(), GetViewport().GetCurrentCamera().GetTransform().ExtractTranslation(),
+                          GetStageOutlinerRow);
 
     // Main Menu bar
     DrawMainMenuBar();
@@ -894,6 +1122,13 @@ void Editor::Draw() {
                 ImGui::Text("\xee\x81\x99"
                             " %.3f ms/frame  (%.1f FPS)",
                             1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+                if (_layerOpener.IsOpening()) {
+                    ImGui::Text("  Layers opened: %zu / %zu", _layerOpener.GetOpenedCount(), _layerOpener.GetLayerCount());
+                }
+                if (_payloadLoader.IsLoading()) {
+                    ImGui::Text("  Payloads loaded: %zu / %zu", _payloadLoader.GetLoadedCount(),
+                                _payloadLoader.GetPayloadCount());
+                }
                 ImGui::EndMenuBar();
             }
         }
@@ -923,7 +1158,7 @@ void Editor::Draw() {
         const ImGuiWindowFlags windowFlagsWithMenu = ImGuiWindowFlags_None | ImGuiWindowFlags_MenuBar;
         TRACE_SCOPE(UsdStageHierarchyWindowTitle);
         ImGui::Begin(UsdStageHierarchyWindowTitle, &_settings._showOutliner, windowFlagsWithMenu);
-        DrawStageOutliner(GetCurrentStage(), _selection);
+        DrawStageOutliner(GetCurrentStage(), _selection, _primSearch, _primFilter);
         ImGui::End();
     }
 
@@ -944,7 +1179,7 @@ void Editor::Draw() {
         const std::string title(SdfLayerHierarchyWindowTitle + (rootLayer ? " - " + rootLayer->GetDisplayName() : "") +
                                 "###Layer hierarchy");
         ImGui::Begin(title.c_str(), &_settings._showLayerHierarchyEditor, layerWindowFlag);
-        DrawLayerPrimHierarchy(rootLayer, GetSelection());
+        DrawLayerPrimHierarchy(rootLayer, GetSelection(), _layerFilter);
         ImGui::End();
     }
 
@@ -1011,7 +1246,7 @@ void Editor::Draw() {
     if (_settings._textEditor) {
         TRACE_SCOPE(SdfLayerAsciiEditorWindowTitle);
         ImGui::Begin(SdfLayerAsciiEditorWindowTitle, &_settings._textEditor);
-            DrawTextEditor(GetCurrentLayer());
+            DrawTextEditor(GetCurrentLayer(), _stageMutex);
         ImGui::End();
     }
 
@@ -1030,6 +1265,8 @@ void Editor::Draw() {
     }
     
     DrawCurrentModal();
+    DrawStageOpenerProgress(_stageOpener);
+    DrawLayerSaves(_layerSaver);
 
     ///////////////////////
     // Top level shortcuts functions
@@ -1,6 +1,13 @@
 #pragma once
 #include "EditorSettings.h"
+#include "LayerOpener.h"
+#include "LayerSaver.h"
+#include "LayerSearch.h"
+#include "PayloadLoader.h"
+#include "PrimNameIndex.h"
+#include "PrimSearch.h"
 #include "Selection.h"
+#include "StageOpener.h"
 #include "Viewport.h"
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/primSpec.h>
@@ -8,6 +15,7 @@
 #include "Constants.h"
 #include <set>
 #include <future>
+#include <mutex>
 
 struct GLFWwindow;
 
@@ -48,6 +56,21 @@ public:
     void SetCurrentStage(UsdStageRefPtr stage);
     void SetCurrentEditTarget(SdfLayerHandle layer);
 
+    /// The stages are read by background tasks while they are not locked, they must be locked to be modified
+    std::unique_lock<std::mutex> LockStages() { return std::unique_lock<std::mutex>(_stageMutex); }
+
+    /// Index of the prim names of the current stage
+    PrimNameIndex &GetPrimNameIndex() { return _primNameIndex; }
+
+    /// Search of all the prims matching a name, running in the background
+    PrimSearch &GetPrimSearch() { return _primSearch; }
+
+    /// Prims shown by the filtered stage outliner, computed in the background
+    PrimSearch &GetPrimFilter() { return _primFilter; }
+
+    /// Specs shown by the filtered layer hierarchy, computed in the background
+    LayerSearch &GetLayerFilter() { return _layerFilter; }
+
     UsdStageCache &GetStageCache() { return _stageCache.Get(); }
 
     /// Returns the selected primspec
@@ -57,13 +80,24 @@ public:
     void AddLayerPathSelection(const SdfPath &primPath);
     void SetStagePathSelection(const SdfPath &primPath);
     void AddStagePathSelection(const SdfPath &primPath);
+    void SetStagePathsSelection(const SdfPathVector &primPaths);
+    void AddStagePathsSelection(const SdfPathVector &primPaths);
     
     /// Create a new layer in file path
     void CreateNewLayer(const std::string &path);
     void FindOrOpenLayer(const std::string &path);
+    /// Open the layers in parallel in the background, they are added to the layer history when they are all opened
+    void FindOrOpenLayers(const std::vector<std::string> &paths);
+    bool IsOpeningLayers() const { return _layerOpener.IsOpening(); }
     void CreateStage(const std::string &path);
-    void OpenStage(const std::string &path, bool openLoaded = true);
+    /// Open the stage in the background, it becomes the current stage when it is ready
+    void OpenStage(const std::string &path, PayloadLoading payloadLoading = PayloadLoading::All);
+    /// Open in the background a new stage of the layers of stage, composing only the prims under the paths.
+    /// It has the session layer and the resolver context of stage and the same payloads loaded
+    void OpenStageSubset(const UsdStageRefPtr &stage, const SdfPathVector &paths);
     void SaveLayerAs(SdfLayerRefPtr layer, const std::string &path);
+    /// Save the layer in the background, it can be edited while it is written
+    void SaveLayer(SdfLayerRefPtr layer);
 
     /// Render the hydra viewport
     void HydraRender();
@@ -117,11 +151,23 @@ public:
     void ScaleUI(float scaleValue);
     float GetScaleUI() const;
 
+    /// Undo history memory budget in megabytes, 0 for unlimited
+    void SetUndoMemoryBudget(int megabytes);
+    int GetUndoMemoryBudget() const;
+
+    /// Crash recovery journal of the edits
+    void SetEditJournalEnabled(bool enabled);
+    bool IsEditJournalEnabled() const;
+
   private:
     /// Interface with the settings
     void LoadSettings();
     void SaveSettings() const;
 
+    /// Make current the stage opened in the background when it is ready, called once per frame
+    void UpdateOpenedStages();
+    void UpdateOpenedLayers();
+
     /// glfw callback to handle drag and drop from external applications
     static void DropCallback(GLFWwindow *window, int count, const char **paths);
 
@@ -166,5 +212,31 @@ public:
     /// Playback controls
     bool _isPlaying = false;
     std::chrono::time_point<std::chrono::steady_clock> _lastFrameTime;
-    
+
+    /// Locked while the stages are modified
+    std::mutex _stageMutex;
+
+    /// Prim names of the current stage, indexed in the background
+    PrimNameIndex _primNameIndex;
+
+    /// Find all search of the stage outliner
+    PrimSearch _primSearch;
+
+    /// Filter of the stage outliner
+    PrimSearch _primFilter;
+
+    /// Filter of the layer hierarchy
+    LayerSearch _layerFilter;
+
+    /// Stages being opened in the background
+    StageOpener _stageOpener;
+
+    /// Layers dropped or opened together, opened in the background
+    LayerOpener _layerOpener;
+
+    /// Layers saved in the background
+    LayerSaver _layerSaver;
+
+    /// Payloads of the last stage opened with a progressive payload loading
+    PayloadLoader _payloadLoader;
 };
@@ -103,6 +103,12 @@ void EditorSettings::ParseLine(const char *line) {
         SplitSemiColon(blueprintsLine, _blueprintLocations);
     } else if (sscanf(line, "UiScale=%f", &valuef) == 1) {
         _uiScale = valuef;
+    } else if (sscanf(line, "UndoMemoryBudget=%i", &value) == 1) {
+        if (value >= 0) {
+            _undoMemoryBudget = value;
+        }
+    } else if (sscanf(line, "EnableEditJournal=%i", &value) == 1) {
+        _enableEditJournal = static_cast<bool>(value);
     }
 }
 
@@ -148,6 +154,8 @@ void EditorSettings::Dump(ImGuiTextBuffer *buf) {
         buf->appendf("BlueprintLocations=%s\n", JoinSemiColon(_blueprintLocations).c_str());
     }
     buf->appendf("UiScale=%f\n", _uiScale);
+    buf->appendf("UndoMemoryBudget=%d\n", _undoMemoryBudget);
+    buf->appendf("EnableEditJournal=%d\n", _enableEditJournal);
 }
 
 void EditorSettings::UpdateRecentFiles(const std::string &newFile) {
@@ -34,6 +34,12 @@ struct EditorSettings {
     int _mainWindowHeight;
     float _uiScale = 1.f;
 
+    /// Memory budget of the undo history in megabytes, 0 for unlimited
+    int _undoMemoryBudget = 2048;
+
+    /// Write the edits in a journal to recover them after a crash
+    bool _enableEditJournal = false;
+
     /// Last file browser directory
     std::string _lastFileBrowserDirectory;
 
@@ -0,0 +1,60 @@
+#include <pxr/base/work/dispatcher.h>
+#include <pxr/usd/ar/resolverScopedCache.h>
+#include "LayerOpener.h"
+
+LayerOpener::~LayerOpener() {
+    if (_task) {
+        _task->thread.join();
+    }
+}
+
+void LayerOpener::Start(const std::vector<std::string> &paths) {
+    _waiting.insert(_waiting.end(), paths.begin(), paths.end());
+    if (!_task) {
+        _StartNext();
+    }
+}
+
+void LayerOpener::_StartNext() {
+    if (_waiting.empty()) {
+        return;
+    }
+    _task.reset(new OpenTask());
+    _task->paths.swap(_waiting);
+    _task->layers.resize(_task->paths.size());
+    _task->thread = std::thread(&LayerOpener::_Open, _task.get());
+}
+
+// The task is joined only when it has finished, the main thread must not wait for the layers to be read
+bool LayerOpener::Update(SdfLayerRefPtrVector &layers) {
+    if (!_task || !_task->finished) {
+        return false;
+    }
+    _task->thread.join();
+    layers.clear();
+    for (const SdfLayerRefPtr &layer : _task->layers) {
+        if (layer) {
+            layers.push_back(layer);
+        }
+    }
+    _task.reset();
+    _StartNext();
+    return true;
+}
+
+// The asset resolver caches are thread local, the tasks share the cache of the worker
+void LayerOpener::_Open(OpenTask *task) {
+    {
+        ArResolverScopedCache resolverCache;
+        WorkDispatcher dispatcher;
+        for (size_t i = 0; i < task->paths.size(); ++i) {
+            dispatcher.Run([task, i, &resolverCache]() {
+                ArResolverScopedCache taskCache(&resolverCache);
+                task->layers[i] = SdfLayer::FindOrOpen(task->paths[i]);
+                task->openedCount++;
+            });
+        }
+        dispatcher.Wait();
+    }
+    task->finished = true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pxr/usd/sdf/layer.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// LayerOpener opens many layers at once on a worker thread, the layers are read in parallel and share the same asset
+/// resolver cache. The layers are returned together once they are all opened, so the editor is updated once.
+/// The layers requested while others are opening are opened in the next batch.
+///
+class LayerOpener {
+  public:
+    LayerOpener() = default;
+    ~LayerOpener();
+
+    /// Open the layers of the paths after the layers already opening
+    void Start(const std::vector<std::string> &paths);
+
+    /// Returns true once all the layers of a batch are opened, layers contains the ones which could be opened.
+    /// Called on the main thread
+    bool Update(SdfLayerRefPtrVector &layers);
+
+    bool IsOpening() const { return _task != nullptr; }
+    size_t GetOpenedCount() const { return _task ? _task->openedCount.load() : 0; }
+    size_t GetLayerCount() const { return _task ? _task->paths.size() : 0; }
+
+  private:
+    struct OpenTask {
+        std::vector<std::string> paths;
+        SdfLayerRefPtrVector layers; // Written by the worker before it has finished
+        std::atomic<size_t> openedCount{0};
+        std::atomic<bool> finished{false};
+        std::thread thread;
+    };
+
+    static void _Open(OpenTask *task);
+    void _StartNext();
+
+    std::unique_ptr<OpenTask> _task;
+    std::vector<std::string> _waiting;
+};
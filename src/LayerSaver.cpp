@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <pxr/base/tf/errorMark.h>
+#include <pxr/usd/sdf/fileFormat.h>
+#include <pxr/usd/sdf/layerStateDelegate.h>
+#include <pxr/usd/usd/usdFileFormat.h>
+#include "Commands.h"
+#include "LayerSaver.h"
+
+namespace {
+// SdfLayer marks itself clean only when it writes its own content, the saved layer gets a state delegate which can be
+// marked clean. It stays on the layer, the undo recorders restore it after their commands. The recorder of an edition
+// spanning multiple frames stays installed between the frames, the delegate is replaced only after the edition
+class SavedLayerStateDelegate : public SdfSimpleLayerStateDelegate {
+  public:
+    static TfRefPtr<SavedLayerStateDelegate> New() { return TfCreateRefPtr(new SavedLayerStateDelegate()); }
+    void MarkAsClean() { _MarkCurrentStateAsClean(); }
+};
+} // namespace
+
+static void MarkLayerAsClean(const SdfLayerHandle &layer) {
+    TfRefPtr<SavedLayerStateDelegate> stateDelegate = SavedLayerStateDelegate::New();
+    layer->SetStateDelegate(stateDelegate);
+    stateDelegate->MarkAsClean();
+}
+
+LayerSaver::LayerSaver() { _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &LayerSaver::OnLayersDidChange); }
+
+// The writes are not interrupted, a file must not be left half written
+LayerSaver::~LayerSaver() {
+    TfNotice::Revoke(_noticeKey);
+    for (auto &task : _tasks) {
+        if (task && task->thread.joinable()) {
+            task->thread.join();
+        }
+    }
+}
+
+void LayerSaver::Start(const SdfLayerRefPtr &layer) {
+    if (!layer) {
+        return;
+    }
+    Save save;
+    save.layer = layer;
+    save.path = layer->GetRealPath();
+    save.startTime = std::chrono::steady_clock::now();
+    std::unique_ptr<SaveTask> task;
+    if (layer->IsAnonymous() || save.path.empty()) {
+        save.status = SaveStatus::Failed;
+        save.errors = "An anonymous layer can't be saved, use \"Save layer as\"";
+    } else {
+        task.reset(new SaveTask());
+        task->path = save.path;
+        task->arguments = layer->GetFileFormatArguments();
+        // The usd format writes the new layers as crate by default, the snapshot keeps the format of the layer
+        if (layer->GetFileFormat()->GetFormatId() == UsdUsdFileFormatTokens->Id) {
+            task->arguments[UsdUsdFileFormatTokens->FormatArg.GetString()] =
+                UsdUsdFileFormat::GetUnderlyingFormatForLayer(*get_pointer(layer)).GetString();
+        }
+        task->snapshot = SdfLayer::CreateAnonymous("snapshot", layer->GetFileFormat(), task->arguments);
+        task->snapshot->TransferContent(layer);
+    }
+    _saves.push_back(save);
+    _tasks.push_back(std::move(task));
+    _StartWaitingSaves();
+}
+
+// A save waits for the previous saves of the same file
+void LayerSaver::_StartWaitingSaves() {
+    for (size_t i = 0; i < _saves.size(); ++i) {
+        if (!_tasks[i] || _saves[i].status != SaveStatus::Waiting) {
+            continue;
+        }
+        const auto previousSaveIsRunning = [&](const Save &previous) {
+            return previous.path == _saves[i].path &&
+                   (previous.status == SaveStatus::Waiting || previous.status == SaveStatus::Writing);
+        };
+        if (std::none_of(_saves.begin(), _saves.begin() + i, previousSaveIsRunning)) {
+            _saves[i].status = SaveStatus::Writing;
+            _saves[i].startTime = std::chrono::steady_clock::now();
+            _tasks[i]->thread = std::thread(&LayerSaver::_Write, _tasks[i].get());
+        }
+    }
+}
+
+void LayerSaver::Update() {
+    bool hasFinished = false;
+    for (size_t i = 0; i < _saves.size(); ++i) {
+        SaveTask *task = _tasks[i].get();
+        if (!task || !task->finished) {
+            continue;
+        }
+        task->thread.join();
+        Save &save = _saves[i];
+        save.duration = std::chrono::steady_clock::now() - save.startTime;
+        if (task->succeeded) {
+            save.status = SaveStatus::Saved;
+            if (save.layer && !task->editedSinceSnapshot) {
+                _savedLayers.push_back(save.layer);
+            }
+        } else {
+            save.status = SaveStatus::Failed;
+            save.errors = task->errors;
+        }
+        _tasks[i].reset();
+        hasFinished = true;
+    }
+    if (hasFinished) {
+        _StartWaitingSaves();
+    }
+    if (!IsEditionActive()) {
+        SdfLayerHandleVector savedLayers;
+        savedLayers.swap(_savedLayers); // the notices sent while marking clean don't modify the vector iterated
+        for (const SdfLayerHandle &layer : savedLayers) {
+            if (layer) {
+                MarkLayerAsClean(layer);
+            }
+        }
+    }
+}
+
+void LayerSaver::ClearFinished() {
+    size_t kept = 0;
+    for (size_t i = 0; i < _saves.size(); ++i) {
+        if (_tasks[i]) {
+            _saves[kept] = _saves[i];
+            _tasks[kept] = std::move(_tasks[i]);
+            kept++;
+        }
+    }
+    _saves.resize(kept);
+    _tasks.resize(kept);
+}
+
+bool LayerSaver::IsSaving() const {
+    return std::any_of(_tasks.begin(), _tasks.end(), [](const std::unique_ptr<SaveTask> &task) { return task != nullptr; });
+}
+
+void LayerSaver::OnLayersDidChange(const SdfNotice::LayersDidChange &notice) {
+    for (const auto &layerChanges : notice.GetChangeListVec()) {
+        _savedLayers.erase(std::remove(_savedLayers.begin(), _savedLayers.end(), layerChanges.first), _savedLayers.end());
+        for (size_t i = 0; i < _saves.size(); ++i) {
+            if (_tasks[i] && layerChanges.first == _saves[i].layer) {
+                _tasks[i]->editedSinceSnapshot = true;
+            }
+        }
+    }
+}
+
+// The errors are reported in the save report instead of the console
+void LayerSaver::_Write(SaveTask *task) {
+    TfErrorMark errorMark;
+    task->succeeded = task->snapshot->Export(task->path, std::string(), task->arguments);
+    for (auto error = errorMark.GetBegin(); error != errorMark.GetEnd(); ++error) {
+        task->errors += error->GetCommentary() + "\n";
+    }
+    errorMark.Clear();
+    if (!task->succeeded && task->errors.empty()) {
+        task->errors = "The layer could not be written";
+    }
+    task->snapshot = SdfLayerRefPtr(); // released on the worker, it can take a while
+    task->finished = true;
+}
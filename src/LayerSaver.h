@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/notice.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// LayerSaver saves the layers on worker threads. The content of the layer is copied to an anonymous layer on the main
+/// thread, this snapshot is written by the worker while the layer can still be edited. The layer is marked as clean
+/// once written, unless it was edited during the write.
+/// The saves of the same layer are written one after the other, the saves of different layers run in parallel.
+///
+class LayerSaver : public TfWeakBase {
+  public:
+    enum class SaveStatus { Waiting = 0, Writing, Saved, Failed };
+
+    /// State of a save, shown in the save report
+    struct Save {
+        SdfLayerHandle layer;
+        std::string path;
+        SaveStatus status = SaveStatus::Waiting;
+        std::string errors;
+        std::chrono::steady_clock::time_point startTime;
+        std::chrono::steady_clock::duration duration{};
+    };
+
+    LayerSaver();
+    ~LayerSaver();
+
+    /// Snapshot the layer and write it in the background
+    void Start(const SdfLayerRefPtr &layer);
+
+    /// Retrieve the finished saves and start the waiting ones, called once per frame on the main thread
+    void Update();
+
+    /// Forget the finished saves
+    void ClearFinished();
+
+    bool IsSaving() const;
+    const std::vector<Save> &GetSaves() const { return _saves; }
+
+    void OnLayersDidChange(const SdfNotice::LayersDidChange &notice);
+
+  private:
+    struct SaveTask {
+        SdfLayerRefPtr snapshot;
+        std::string path;
+        SdfLayer::FileFormatArguments arguments;
+        bool editedSinceSnapshot = false;
+        std::atomic<bool> finished{false};
+        bool succeeded = false; // Written by the worker before it has finished
+        std::string errors;     // Written by the worker before it has finished
+        std::thread thread;
+    };
+
+    static void _Write(SaveTask *task);
+    void _StartWaitingSaves();
+
+    std::vector<Save> _saves;
+    std::vector<std::unique_ptr<SaveTask>> _tasks; // One per save, null when the save is finished
+    SdfLayerHandleVector _savedLayers;              // Saved and not edited since, waiting to be marked clean
+    TfNotice::Key _noticeKey;
+};
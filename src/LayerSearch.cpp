@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <pxr/base/work/loops.h>
+#include <pxr/base/work/threadLimits.h>
+#include <pxr/usd/sdf/schema.h>
+#include "LayerSearch.h"
+#include "PrimSearch.h"
+
+// Number of specs traversed before the worker releases the stage mutex, shared between the subtrees
+static constexpr size_t SearchedSpecsPerLock = 8192;
+
+// The subtrees are split until there are enough of them to keep all the threads busy
+static constexpr size_t SubtreesPerThread = 4;
+static constexpr int MaxSplitDepth = 8;
+
+LayerSearch::LayerSearch(std::mutex &stageMutex) : _stageMutex(stageMutex) {
+    _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &LayerSearch::OnLayersDidChange);
+}
+
+LayerSearch::~LayerSearch() {
+    TfNotice::Revoke(_noticeKey);
+    Cancel();
+    for (auto &task : _cancelledTasks) {
+        task->thread.join();
+    }
+}
+
+void LayerSearch::Start(const SdfLayerRefPtr &layer, const SpecPathMatcher &matches) {
+    Cancel();
+    // The previous results are kept until the new ones are ready
+    if (SdfLayerHandle(layer) != _layer) {
+        Clear();
+    }
+    _layer = layer;
+    _isStale = false;
+    if (!layer) {
+        return;
+    }
+    _task.reset(new SearchTask());
+    _task->layer = layer;
+    _task->matches = matches;
+    _task->thread = std::thread(&LayerSearch::_Search, _task.get(), &_stageMutex);
+}
+
+// The thread is joined in the next Update, the stage mutex might be locked by the caller
+void LayerSearch::Cancel() {
+    if (_task) {
+        _task->cancelled = true;
+        _cancelledTasks.push_back(std::move(_task));
+    }
+}
+
+void LayerSearch::Clear() {
+    _results.clear();
+    _matchingPaths.clear();
+    _isStale = false;
+}
+
+bool LayerSearch::IsMatching(const SdfPath &path) const {
+    return std::binary_search(_matchingPaths.begin(), _matchingPaths.end(), path);
+}
+
+void LayerSearch::Update() {
+    for (auto &task : _cancelledTasks) {
+        task->thread.join();
+    }
+    _cancelledTasks.clear();
+    if (_task && _task->finished) {
+        _task->thread.join();
+        _results.swap(_task->results);
+        _matchingPaths.swap(_task->matchingPaths);
+        _task.reset();
+    }
+}
+
+void LayerSearch::OnLayersDidChange(const SdfNotice::LayersDidChange &notice) {
+    for (const auto &layerChanges : notice.GetChangeListVec()) {
+        if (layerChanges.first != _layer) {
+            continue;
+        }
+        if (_task) {
+            _task->restart = true;
+        } else {
+            _isStale = true;
+        }
+    }
+}
+
+// Append the prim and variant specs under path, the variant sets are skipped like in the layer hierarchy
+static void AppendChildSpecs(const SdfLayerRefPtr &layer, const SdfPath &path, SdfPathVector &children) {
+    const VtValue primChildren = layer->GetField(path, SdfChildrenKeys->PrimChildren);
+    if (primChildren.IsHolding<TfTokenVector>()) {
+        for (const TfToken &name : primChildren.UncheckedGet<TfTokenVector>()) {
+            children.push_back(path.AppendChild(name));
+        }
+    }
+    const VtValue variantSetChildren = layer->GetField(path, SdfChildrenKeys->VariantSetChildren);
+    if (variantSetChildren.IsHolding<TfTokenVector>()) {
+        for (const TfToken &variantSet : variantSetChildren.UncheckedGet<TfTokenVector>()) {
+            const SdfPath variantSetPath = path.AppendVariantSelection(variantSet, "");
+            const VtValue variantChildren = layer->GetField(variantSetPath, SdfChildrenKeys->VariantChildren);
+            if (variantChildren.IsHolding<TfTokenVector>()) {
+                for (const TfToken &variant : variantChildren.UncheckedGet<TfTokenVector>()) {
+                    children.push_back(path.AppendVariantSelection(variantSet, variant));
+                }
+            }
+        }
+    }
+}
+
+namespace {
+// Traversal of a layer subtree which can be continued after the stage mutex was released
+struct SpecCursor {
+    SpecCursor(const SdfPath &path) : pathsToVisit(1, path) {}
+    SdfPathVector pathsToVisit;
+    SdfPathVector results;
+};
+} // namespace
+
+// Split the layer in subtrees, the specs above the subtrees are tested here
+static std::vector<std::unique_ptr<SpecCursor>> SplitLayer(const SdfLayerRefPtr &layer, const SpecPathMatcher &matches,
+                                                           SdfPathVector &results) {
+    const size_t minSubtrees = SubtreesPerThread * WorkGetConcurrencyLimit();
+    SdfPathVector subtrees;
+    AppendChildSpecs(layer, SdfPath::AbsoluteRootPath(), subtrees);
+    for (int depth = 0; depth < MaxSplitDepth && subtrees.size() < minSubtrees && !subtrees.empty(); ++depth) {
+        SdfPathVector children;
+        for (const SdfPath &path : subtrees) {
+            if (matches(path)) {
+                results.push_back(path);
+            }
+            AppendChildSpecs(layer, path, children);
+        }
+        subtrees.swap(children);
+    }
+    std::vector<std::unique_ptr<SpecCursor>> cursors;
+    for (const SdfPath &path : subtrees) {
+        cursors.emplace_back(new SpecCursor(path));
+    }
+    return cursors;
+}
+
+void LayerSearch::_Search(SearchTask *task, std::mutex *stageMutex) {
+    std::vector<std::unique_ptr<SpecCursor>> cursors;
+    SdfPathVector matchingPaths;
+    bool restart = true;
+    while (!task->cancelled) {
+        std::vector<SpecCursor *> activeCursors;
+        {
+            std::lock_guard<std::mutex> stageLock(*stageMutex);
+            // The layer was changed between two batches, the paths to visit might have been removed
+            if (restart || task->restart) {
+                task->restart = false;
+                restart = false;
+                matchingPaths.clear();
+                cursors = SplitLayer(task->layer, task->matches, matchingPaths);
+            }
+            for (auto &cursor : cursors) {
+                if (!cursor->pathsToVisit.empty()) {
+                    activeCursors.push_back(cursor.get());
+                }
+            }
+            const size_t specsPerCursor = std::max<size_t>(SearchedSpecsPerLock / std::max<size_t>(activeCursors.size(), 1), 1);
+            WorkParallelForEach(activeCursors.begin(), activeCursors.end(), [task, specsPerCursor](SpecCursor *cursor) {
+                for (size_t i = 0; i < specsPerCursor && !cursor->pathsToVisit.empty(); ++i) {
+                    const SdfPath path = cursor->pathsToVisit.back();
+                    cursor->pathsToVisit.pop_back();
+                    if (task->matches(path)) {
+                        cursor->results.push_back(path);
+                    }
+                    AppendChildSpecs(task->layer, path, cursor->pathsToVisit);
+                }
+            });
+        }
+        for (SpecCursor *cursor : activeCursors) {
+            matchingPaths.insert(matchingPaths.end(), cursor->results.begin(), cursor->results.end());
+            cursor->results.clear();
+        }
+        if (activeCursors.empty()) {
+            break;
+        }
+        // Let the main thread modify the layer
+        std::this_thread::yield();
+    }
+    if (!task->cancelled) {
+        std::sort(matchingPaths.begin(), matchingPaths.end());
+        task->results = AddAncestorPaths(matchingPaths);
+        task->matchingPaths.swap(matchingPaths);
+    }
+    task->finished = true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/notice.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+using SpecPathMatcher = std::function<bool(const SdfPath &)>;
+
+///
+/// LayerSearch finds all the prim and variant specs of a layer matching a path matcher, with their ancestors to show
+/// them in a tree.
+/// The layer subtrees are traversed in parallel on a worker thread, in batches while holding the stage mutex like
+/// the PrimSearch, as the layers are modified only while the mutex is locked, by the commands and by the edits using
+/// LockStagesForEdition. A change of the layer
+/// restarts the search. The results replace the previous results at once when the search is finished.
+/// The matcher is called concurrently by multiple threads.
+///
+class LayerSearch : public TfWeakBase {
+  public:
+    LayerSearch(std::mutex &stageMutex);
+    ~LayerSearch();
+
+    /// Start a new search of the layer specs. The running search is cancelled
+    void Start(const SdfLayerRefPtr &layer, const SpecPathMatcher &matches);
+    void Cancel();
+
+    /// Retrieve the results when the worker has finished, called on the main thread
+    void Update();
+
+    bool IsRunning() const { return _task != nullptr; }
+
+    /// The layer was changed after the search finished, the results might be outdated
+    bool IsStale() const { return _isStale; }
+
+    /// Paths found with their ancestors, sorted
+    const SdfPathVector &GetResults() const { return _results; }
+
+    /// Returns false for the ancestors which are part of the results but don't match
+    bool IsMatching(const SdfPath &path) const;
+
+    /// Removes the results
+    void Clear();
+
+    void OnLayersDidChange(const SdfNotice::LayersDidChange &notice);
+
+  private:
+    struct SearchTask {
+        SdfLayerRefPtr layer;
+        SpecPathMatcher matches;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> restart{false};
+        std::atomic<bool> finished{false};
+        // Written by the worker before it has finished
+        SdfPathVector results;
+        SdfPathVector matchingPaths;
+        std::thread thread;
+    };
+
+    static void _Search(SearchTask *task, std::mutex *stageMutex);
+
+    std::mutex &_stageMutex;
+    std::unique_ptr<SearchTask> _task;
+    std::vector<std::unique_ptr<SearchTask>> _cancelledTasks;
+    SdfPathVector _results;
+    SdfPathVector _matchingPaths; // sorted
+    SdfLayerHandle _layer;
+    bool _isStale = false;
+    TfNotice::Key _noticeKey;
+};
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <limits>
+#include <pxr/base/work/loops.h>
+#include <pxr/usd/ar/resolverContextBinder.h>
+#include <pxr/usd/sdf/layerUtils.h>
+#include <pxr/usd/sdf/listOp.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/sdf/schema.h>
+#include <pxr/usd/usdGeom/xformCache.h>
+#include "PayloadLoader.h"
+
+// Number of payloads whose layers are opened together in the background
+static constexpr size_t PrefetchedPayloadsPerBatch = 64;
+
+// Time spent loading the payloads on the main thread at each frame
+static constexpr std::chrono::milliseconds LoadingBudget(8);
+
+// The priorities change with the camera and the outliner, the payloads are sorted again at this interval
+static constexpr std::chrono::milliseconds SortInterval(250);
+
+PayloadLoader::PayloadLoader(std::mutex &stageMutex) : _stageMutex(stageMutex) {}
+
+PayloadLoader::~PayloadLoader() { Stop(); }
+
+void PayloadLoader::Start(const UsdStageRefPtr &stage, PayloadOrder order) {
+    Stop();
+    if (!stage) {
+        return;
+    }
+    _stage = stage;
+    _order = order;
+    const SdfPathSet loaded = stage->GetLoadSet();
+    UsdGeomXformCache xformCache;
+    for (const SdfPath &path : stage->FindLoadable()) {
+        if (loaded.count(path)) {
+            continue;
+        }
+        const UsdPrim prim = stage->GetPrimAtPath(path);
+        _pending.push_back({path, xformCache.GetLocalToWorldTransform(prim).ExtractTranslation(), 0.0});
+    }
+    _payloadCount = _pending.size();
+}
+
+// The layers being opened are released when the future is ready, Stop doesn't wait for them
+void PayloadLoader::Stop() {
+    if (_prefetch.valid()) {
+        _stoppedPrefetches.push_back(std::move(_prefetch));
+    }
+    _stage = UsdStageWeakPtr();
+    _pending.clear();
+    _prefetchedPaths.clear();
+    _prefetchedLayers.clear();
+    _readyPaths.clear();
+    _batchSize = 1;
+    _loadedCount = 0;
+    _payloadCount = 0;
+    _lastSortTime = std::chrono::steady_clock::time_point();
+}
+
+void PayloadLoader::Update(const UsdStageRefPtr &currentStage, const GfVec3d &cameraPosition,
+                           const OutlinerRowFunction &outlinerRow) {
+    _stoppedPrefetches.erase(std::remove_if(_stoppedPrefetches.begin(), _stoppedPrefetches.end(),
+                                            [](const std::future<SdfLayerRefPtrVector> &prefetch) {
+                                                return prefetch.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                            }),
+                             _stoppedPrefetches.end());
+    if (!_stage || get_pointer(currentStage) != get_pointer(_stage)) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - _lastSortTime > SortInterval) {
+        _SortPending(cameraPosition, outlinerRow);
+        _lastSortTime = now;
+    }
+    if (_prefetch.valid() && _prefetch.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        const SdfLayerRefPtrVector layers = _prefetch.get();
+        _prefetchedLayers.insert(_prefetchedLayers.end(), layers.begin(), layers.end());
+        _readyPaths.insert(_readyPaths.begin(), _prefetchedPaths.rbegin(), _prefetchedPaths.rend());
+        _prefetchedPaths.clear();
+    }
+    if (!_prefetch.valid()) {
+        _StartPrefetch(currentStage);
+    }
+    _LoadReadyPayloads(currentStage);
+}
+
+void PayloadLoader::_SortPending(const GfVec3d &cameraPosition, const OutlinerRowFunction &outlinerRow) {
+    for (Payload &payload : _pending) {
+        if (_order == PayloadOrder::ClosestToCamera) {
+            payload.priority = -(payload.position - cameraPosition).GetLengthSq();
+        } else {
+            // A payload which is not shown comes after the row of its closest shown ancestor
+            int row = -1;
+            for (SdfPath path = payload.path; row < 0 && !path.IsEmpty(); path = path.GetParentPath()) {
+                row = outlinerRow(path);
+            }
+            payload.priority = row < 0 ? std::numeric_limits<double>::lowest() : -static_cast<double>(row);
+        }
+    }
+    std::sort(_pending.begin(), _pending.end(),
+              [](const Payload &a, const Payload &b) { return a.priority < b.priority; });
+}
+
+// Returns the identifiers of the layers of the payloads authored on the prim, the internal payloads are skipped
+static void AppendPayloadLayers(const UsdPrim &prim, std::vector<std::string> &identifiers) {
+    for (const SdfPrimSpecHandle &spec : prim.GetPrimStack()) {
+        SdfPayloadListOp payloads;
+        if (!spec->GetLayer()->HasField(spec->GetPath(), SdfFieldKeys->Payload, &payloads)) {
+            continue;
+        }
+        for (const SdfPayload &payload : payloads.GetAppliedItems()) {
+            if (!payload.GetAssetPath().empty()) {
+                identifiers.push_back(SdfComputeAssetPathRelativeToLayer(spec->GetLayer(), payload.GetAssetPath()));
+            }
+        }
+    }
+}
+
+// The composition of the payload will find its layers already opened, the layers they reference are still read on the
+// main thread. A layer which fails to open here is reported when the payload is loaded
+void PayloadLoader::_StartPrefetch(const UsdStageRefPtr &stage) {
+    std::vector<std::string> identifiers;
+    while (!_pending.empty() && _prefetchedPaths.size() < PrefetchedPayloadsPerBatch) {
+        const SdfPath path = _pending.back().path;
+        _pending.pop_back();
+        if (const UsdPrim prim = stage->GetPrimAtPath(path)) {
+            AppendPayloadLayers(prim, identifiers);
+            _prefetchedPaths.push_back(path);
+        } else {
+            _loadedCount++; // removed from the stage
+        }
+    }
+    if (_prefetchedPaths.empty()) {
+        return;
+    }
+    const ArResolverContext context = stage->GetPathResolverContext();
+    _prefetch = std::async(std::launch::async, [identifiers, context]() {
+        SdfLayerRefPtrVector layers(identifiers.size());
+        WorkParallelForN(identifiers.size(), [&](size_t begin, size_t end) {
+            ArResolverContextBinder binder(context);
+            for (size_t i = begin; i < end; ++i) {
+                layers[i] = SdfLayer::FindOrOpen(identifiers[i]);
+            }
+        });
+        return layers;
+    });
+}
+
+// The batch size grows or shrinks to fit the loading budget
+void PayloadLoader::_LoadReadyPayloads(const UsdStageRefPtr &stage) {
+    const auto start = std::chrono::steady_clock::now();
+    while (!_readyPaths.empty() && std::chrono::steady_clock::now() - start < LoadingBudget) {
+        SdfPathSet batch;
+        while (batch.size() < _batchSize && !_readyPaths.empty()) {
+            batch.insert(_readyPaths.back());
+            _readyPaths.pop_back();
+        }
+        const auto batchStart = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(_stageMutex);
+            stage->LoadAndUnload(batch, SdfPathSet());
+        }
+        const auto batchDuration = std::chrono::steady_clock::now() - batchStart;
+        _loadedCount += batch.size();
+        if (batchDuration < LoadingBudget / 4) {
+            _batchSize *= 2;
+        } else if (batchDuration > LoadingBudget && _batchSize > 1) {
+            _batchSize /= 2;
+        }
+    }
+    // The stage holds the layers of the loaded payloads
+    if (_readyPaths.empty()) {
+        _prefetchedLayers.clear();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+/// Payloads loaded first by the PayloadLoader
+enum class PayloadOrder { ClosestToCamera = 0, OutlinerRows };
+
+///
+/// PayloadLoader loads the payloads of a stage opened without them, a few at a time, so the stage can be used while
+/// they arrive. The layers of the next payloads are opened in parallel in the background, then the payloads are
+/// loaded with LoadAndUnload on the main thread within a time budget per frame, as the main thread reads the stage
+/// without locking it. The stage mutex is locked while loading, for the background tasks reading the stage.
+/// The payloads closest to the camera, or shown in the outliner, are loaded first.
+///
+class PayloadLoader {
+  public:
+    using OutlinerRowFunction = std::function<int(const SdfPath &)>;
+
+    PayloadLoader(std::mutex &stageMutex);
+    ~PayloadLoader();
+
+    /// Start loading the payloads of the stage which are not loaded, the loading of the previous stage is stopped
+    void Start(const UsdStageRefPtr &stage, PayloadOrder order);
+    void Stop();
+
+    /// Load the next payloads when the stage is the current stage, called once per frame on the main thread.
+    /// outlinerRow returns the row of a prim in the outliner, or -1 when it is not shown
+    void Update(const UsdStageRefPtr &currentStage, const GfVec3d &cameraPosition, const OutlinerRowFunction &outlinerRow);
+
+    bool IsLoading() const { return _stage && _loadedCount < _payloadCount; }
+    size_t GetLoadedCount() const { return _loadedCount; }
+    size_t GetPayloadCount() const { return _payloadCount; }
+
+  private:
+    struct Payload {
+        SdfPath path;
+        GfVec3d position;
+        double priority;
+    };
+
+    void _SortPending(const GfVec3d &cameraPosition, const OutlinerRowFunction &outlinerRow);
+    void _StartPrefetch(const UsdStageRefPtr &stage);
+    void _LoadReadyPayloads(const UsdStageRefPtr &stage);
+
+    std::mutex &_stageMutex;
+    UsdStageWeakPtr _stage;
+    PayloadOrder _order = PayloadOrder::ClosestToCamera;
+    std::vector<Payload> _pending; // sorted by priority, the next payload is at the back
+    SdfPathVector _prefetchedPaths; // their layers are being opened
+    std::future<SdfLayerRefPtrVector> _prefetch;
+    std::vector<std::future<SdfLayerRefPtrVector>> _stoppedPrefetches;
+    SdfLayerRefPtrVector _prefetchedLayers; // kept opened until their payloads are loaded
+    SdfPathVector _readyPaths; // their layers are opened, the next payload is at the back
+    size_t _batchSize = 1;
+    size_t _loadedCount = 0;
+    size_t _payloadCount = 0;
+    std::chrono::steady_clock::time_point _lastSortTime;
+};
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <unordered_set>
+#include <pxr/usd/usd/primRange.h>
+#include "PrimNameIndex.h"
+
+// Number of prims indexed before the worker releases the stage mutex
+static constexpr size_t IndexedPrimsPerLock = 4096;
+
+static Usd_PrimFlagsPredicate IndexedPrimsPredicate() { return UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate); }
+
+PrimNameIndex::PrimNameIndex(std::mutex &stageMutex) : _stageMutex(stageMutex) {
+    _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &PrimNameIndex::OnObjectsChanged);
+}
+
+PrimNameIndex::~PrimNameIndex() {
+    TfNotice::Revoke(_noticeKey);
+    _CancelBuild();
+    for (auto &build : _cancelledBuilds) {
+        build->thread.join();
+    }
+}
+
+void PrimNameIndex::SetStage(const UsdStageRefPtr &stage) {
+    if (get_pointer(stage) == get_pointer(_stage)) {
+        return;
+    }
+    _stage = stage;
+    _StartBuild();
+}
+
+void PrimNameIndex::_StartBuild() {
+    _CancelBuild();
+    _postings.clear();
+    _names.clear();
+    _isReady = false;
+    _resyncedPaths.clear();
+    if (_stage) {
+        _build.reset(new BuildTask());
+        _build->stage = _stage;
+        _build->thread = std::thread(&PrimNameIndex::_Build, _build.get(), &_stageMutex);
+    }
+}
+
+// The thread is not joined here, SetStage can be called by a command while the stage mutex is locked
+void PrimNameIndex::_CancelBuild() {
+    if (_build) {
+        _build->cancelled = true;
+        _cancelledBuilds.push_back(std::move(_build));
+    }
+}
+
+void PrimNameIndex::_Build(BuildTask *task, std::mutex *stageMutex) {
+    std::unique_lock<std::mutex> lock(*stageMutex);
+    UsdPrimRange range = UsdPrimRange::Stage(task->stage, IndexedPrimsPredicate());
+    auto iter = range.begin();
+    while (!task->cancelled) {
+        // The stage was resynced between two batches, the iterator might point to deleted prims
+        if (task->restart) {
+            task->restart = false;
+            task->postings.clear();
+            task->names.clear();
+            range = UsdPrimRange::Stage(task->stage, IndexedPrimsPredicate());
+            iter = range.begin();
+        }
+        if (iter == range.end()) {
+            break;
+        }
+        for (size_t i = 0; i < IndexedPrimsPerLock && iter != range.end(); ++i, ++iter) {
+            task->postings[iter->GetName()].push_back(iter->GetPath());
+            task->names.insert({iter->GetPath(), iter->GetName()});
+        }
+        // Let the main thread modify the stage
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+    // The range must be released while the stage can't be modified
+    iter = UsdPrimRange::iterator();
+    range = UsdPrimRange();
+    lock.unlock();
+    for (auto &namePaths : task->postings) {
+        std::sort(namePaths.second.begin(), namePaths.second.end());
+    }
+    task->finished = true;
+}
+
+void PrimNameIndex::Update() {
+    for (auto &build : _cancelledBuilds) {
+        build->thread.join();
+    }
+    _cancelledBuilds.clear();
+
+    if (_build && _build->finished) {
+        _build->thread.join();
+        _postings.swap(_build->postings);
+        _names.swap(_build->names);
+        _build.reset();
+        _isReady = true;
+        // The resyncs received during the build are applied again, it doesn't matter if they were already indexed
+    }
+    if (!_isReady || _resyncedPaths.empty()) {
+        return;
+    }
+    for (const SdfPath &path : _resyncedPaths) {
+        // The instance proxies of a prototype are under all its instances
+        if (path.IsAbsoluteRootPath() || UsdPrim::IsPathInPrototype(path)) {
+            _StartBuild();
+            return;
+        }
+    }
+    SdfPath::RemoveDescendentPaths(&_resyncedPaths);
+    for (const SdfPath &path : _resyncedPaths) {
+        _RemoveSubtree(path);
+        _IndexSubtree(path);
+    }
+    _resyncedPaths.clear();
+}
+
+void PrimNameIndex::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice) {
+    if (notice.GetStage() != _stage) {
+        return;
+    }
+    // Only the resyncs can add, remove or rename prims
+    for (const SdfPath &path : notice.GetResyncedPaths()) {
+        if (path.IsAbsoluteRootOrPrimPath()) {
+            _resyncedPaths.push_back(path);
+            if (_build) {
+                _build->restart = true;
+            }
+        }
+    }
+}
+
+// Only the name lists of the indexed prims of the subtree are modified, the descendants of a path follow it in the
+// path order
+void PrimNameIndex::_RemoveSubtree(const SdfPath &path) {
+    const auto found = _names.find(path);
+    if (found == _names.end()) {
+        return;
+    }
+    std::unordered_set<TfToken, TfToken::HashFunctor> subtreeNames;
+    const auto subtree = _names.FindSubtreeRange(path);
+    for (auto it = subtree.first; it != subtree.second; ++it) {
+        subtreeNames.insert(it->second);
+    }
+    _names.erase(found);
+    for (const TfToken &name : subtreeNames) {
+        const auto posting = _postings.find(name);
+        if (posting == _postings.end()) {
+            continue;
+        }
+        SdfPathVector &paths = posting->second;
+        auto subtreeBegin = std::lower_bound(paths.begin(), paths.end(), path);
+        auto subtreeEnd = subtreeBegin;
+        while (subtreeEnd != paths.end() && subtreeEnd->HasPrefix(path)) {
+            ++subtreeEnd;
+        }
+        paths.erase(subtreeBegin, subtreeEnd);
+        if (paths.empty()) {
+            _postings.erase(posting);
+        }
+    }
+}
+
+void PrimNameIndex::_IndexSubtree(const SdfPath &path) {
+    const UsdPrim prim = _stage->GetPrimAtPath(path);
+    if (!prim) {
+        return;
+    }
+    Postings subtreePostings;
+    for (const UsdPrim &subtreePrim : UsdPrimRange(prim, IndexedPrimsPredicate())) {
+        subtreePostings[subtreePrim.GetName()].push_back(subtreePrim.GetPath());
+        _names.insert({subtreePrim.GetPath(), subtreePrim.GetName()});
+    }
+    for (auto &namePaths : subtreePostings) {
+        SdfPathVector &newPaths = namePaths.second;
+        std::sort(newPaths.begin(), newPaths.end());
+        SdfPathVector &paths = _postings[namePaths.first];
+        const size_t previousSize = paths.size();
+        paths.insert(paths.end(), newPaths.begin(), newPaths.end());
+        std::inplace_merge(paths.begin(), paths.begin() + previousSize, paths.end());
+    }
+}
+
+SdfPathVector PrimNameIndex::FindAll(const NameMatcher &matches) const {
+    SdfPathVector found;
+    for (const auto &namePaths : _postings) {
+        if (matches(namePaths.first.GetString())) {
+            found.insert(found.end(), namePaths.second.begin(), namePaths.second.end());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+SdfPath PrimNameIndex::FindNext(const NameMatcher &matches, const SdfPath &after) const {
+    SdfPath first;
+    SdfPath next;
+    for (const auto &namePaths : _postings) {
+        if (!matches(namePaths.first.GetString())) {
+            continue;
+        }
+        const SdfPathVector &paths = namePaths.second;
+        if (first.IsEmpty() || paths.front() < first) {
+            first = paths.front();
+        }
+        auto found = std::upper_bound(paths.begin(), paths.end(), after);
+        if (found != paths.end() && (next.IsEmpty() || *found < next)) {
+            next = *found;
+        }
+    }
+    return next.IsEmpty() ? first : next;
+}
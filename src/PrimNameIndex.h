@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/pathTable.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// PrimNameIndex maps the prim names of a stage to their paths, instance proxies included, to find the prims
+/// by name without traversing the stage.
+/// The index is built on a worker thread when the stage is set, it reads the stage only while holding the stage
+/// mutex, so the stage must be modified only while the mutex is locked: the commands are executed with the mutex
+/// locked, the other edits, like the manipulator drags, lock it with LockStagesForEdition.
+/// Once built, it is patched on the main thread with the resyncs of the stage. The indexed paths are kept in a path
+/// table, a resync only touches the name lists of the prims of the resynced subtree.
+///
+class PrimNameIndex : public TfWeakBase {
+  public:
+    using NameMatcher = std::function<bool(const std::string &)>;
+
+    PrimNameIndex(std::mutex &stageMutex);
+    ~PrimNameIndex();
+
+    /// Start indexing a new stage, the previous index is discarded
+    void SetStage(const UsdStageRefPtr &stage);
+
+    /// Retrieve the index when the worker has finished and apply the resyncs of the stage, called once per frame
+    void Update();
+
+    /// The index is built and up to date, it can be searched
+    bool IsReady() const { return _isReady; }
+
+    /// Returns the paths of all the prims whose name matches, in the path order
+    SdfPathVector FindAll(const NameMatcher &matches) const;
+
+    /// Returns the first matching path after the given path in the path order, or the first matching path
+    /// if there is none after it. Returns an empty path if no names match
+    SdfPath FindNext(const NameMatcher &matches, const SdfPath &after) const;
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice);
+
+  private:
+    // Sorted paths of the prims by name
+    using Postings = std::unordered_map<TfToken, SdfPathVector, TfToken::HashFunctor>;
+    // Name of the indexed prims by path, the ancestors of a path are always in the table
+    using IndexedNames = SdfPathTable<TfToken>;
+
+    struct BuildTask {
+        UsdStageRefPtr stage;
+        Postings postings;
+        IndexedNames names;
+        std::atomic<bool> restart{false};
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> finished{false};
+        std::thread thread;
+    };
+
+    static void _Build(BuildTask *task, std::mutex *stageMutex);
+    void _StartBuild();
+    void _CancelBuild();
+    void _RemoveSubtree(const SdfPath &path);
+    void _IndexSubtree(const SdfPath &path);
+
+    std::mutex &_stageMutex;
+    UsdStageWeakPtr _stage;
+    Postings _postings;
+    IndexedNames _names;
+    bool _isReady = false;
+    std::unique_ptr<BuildTask> _build;
+    std::vector<std::unique_ptr<BuildTask>> _cancelledBuilds;
+    SdfPathVector _resyncedPaths;
+    TfNotice::Key _noticeKey;
+};
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <memory>
+#include <regex>
+#include <unordered_set>
+#include <pxr/base/work/loops.h>
+#include <pxr/base/work/threadLimits.h>
+#include <pxr/usd/usd/primRange.h>
+#include "PrimSearch.h"
+#include "WildcardsCompare.h"
+
+// Number of prims traversed before the worker releases the stage mutex, shared between the subtrees
+static constexpr size_t SearchedPrimsPerLock = 8192;
+
+// The subtrees are split until there are enough of them to keep all the threads busy
+static constexpr size_t SubtreesPerThread = 4;
+static constexpr int MaxSplitDepth = 8;
+
+PrimNameMatcher MakePrimNameMatcher(const std::string &pattern, PrimNameMatch match, std::string *errorMessage) {
+    if (match == PrimNameMatch::Wildcards) {
+        return [pattern](const std::string &name) { return FastWildComparePortable(pattern.c_str(), name.c_str()); };
+    } else if (match == PrimNameMatch::Regex) {
+        try {
+            auto regex = std::make_shared<const std::regex>(pattern);
+            return [regex](const std::string &name) { return std::regex_match(name, *regex); };
+        } catch (const std::regex_error &error) {
+            if (errorMessage) {
+                *errorMessage = error.what();
+            }
+            return [](const std::string &) { return false; };
+        }
+    }
+    return [pattern](const std::string &name) { return name == pattern; };
+}
+
+PrimSearch::PrimSearch(std::mutex &stageMutex) : _stageMutex(stageMutex) {
+    _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &PrimSearch::OnObjectsChanged);
+}
+
+PrimSearch::~PrimSearch() {
+    TfNotice::Revoke(_noticeKey);
+    Cancel();
+    for (auto &task : _cancelledTasks) {
+        task->thread.join();
+    }
+}
+
+void PrimSearch::Start(const UsdStageRefPtr &stage, const std::string &pattern, PrimNameMatch match) {
+    Clear();
+    std::string errorMessage;
+    const PrimNameMatcher nameMatches = MakePrimNameMatcher(pattern, match, &errorMessage);
+    Start(
+        stage, [nameMatches](const UsdPrim &prim) { return nameMatches(prim.GetName().GetString()); },
+        UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate), false);
+    _errorMessage = errorMessage;
+}
+
+void PrimSearch::Start(const UsdStageRefPtr &stage, const PrimMatcher &matches, const Usd_PrimFlagsPredicate &predicate,
+                       bool withAncestors) {
+    Cancel();
+    // The previous results with ancestors are kept until the new ones are ready
+    if (!withAncestors || !_withAncestors || get_pointer(stage) != get_pointer(_stage)) {
+        Clear();
+    }
+    _stage = stage;
+    _withAncestors = withAncestors;
+    _isStale = false;
+    if (!stage) {
+        return;
+    }
+    _task.reset(new SearchTask());
+    _task->stage = stage;
+    _task->matches = matches;
+    _task->predicate = predicate;
+    _task->withAncestors = withAncestors;
+    _task->thread = std::thread(&PrimSearch::_Search, _task.get(), &_stageMutex);
+}
+
+// The thread is joined in the next Update, the stage mutex might be locked by the caller
+void PrimSearch::Cancel() {
+    if (_task) {
+        _task->cancelled = true;
+        _cancelledTasks.push_back(std::move(_task));
+    }
+}
+
+void PrimSearch::Clear() {
+    _results.clear();
+    _matches.clear();
+    _errorMessage.clear();
+    _isStale = false;
+}
+
+bool PrimSearch::IsMatching(const SdfPath &path) const {
+    return !_withAncestors || std::binary_search(_matches.begin(), _matches.end(), path);
+}
+
+void PrimSearch::Update() {
+    for (auto &task : _cancelledTasks) {
+        task->thread.join();
+    }
+    _cancelledTasks.clear();
+    if (!_task) {
+        return;
+    }
+    const bool finished = _task->finished;
+    {
+        std::lock_guard<std::mutex> lock(_task->resultsMutex);
+        if (_task->clearResults) {
+            _results.clear();
+            _matches.clear();
+            _task->clearResults = false;
+        }
+        _results.insert(_results.end(), _task->newResults.begin(), _task->newResults.end());
+        _task->newResults.clear();
+        _matches.insert(_matches.end(), _task->newMatches.begin(), _task->newMatches.end());
+        _task->newMatches.clear();
+    }
+    if (finished) {
+        _task->thread.join();
+        _task.reset();
+        std::sort(_results.begin(), _results.end());
+    }
+}
+
+void PrimSearch::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice) {
+    if (notice.GetStage() != _stage || notice.GetResyncedPaths().empty()) {
+        return;
+    }
+    if (_task) {
+        _task->restart = true;
+    } else {
+        _isStale = true;
+    }
+}
+
+namespace {
+// Traversal of a stage subtree which can be continued after the stage mutex was released
+struct SubtreeCursor {
+    SubtreeCursor(const UsdPrim &prim, const Usd_PrimFlagsPredicate &predicate)
+        : range(prim, predicate), iter(range.begin()) {}
+    UsdPrimRange range;
+    UsdPrimRange::iterator iter;
+    SdfPathVector results;
+};
+} // namespace
+
+// Split the stage in subtrees, the prims above the subtrees are tested here
+static std::vector<std::unique_ptr<SubtreeCursor>> SplitStage(const UsdStageRefPtr &stage, const PrimMatcher &matches,
+                                                              const Usd_PrimFlagsPredicate &predicate, SdfPathVector &results) {
+    const size_t minSubtrees = SubtreesPerThread * WorkGetConcurrencyLimit();
+    std::vector<UsdPrim> subtrees;
+    for (const UsdPrim &child : stage->GetPseudoRoot().GetFilteredChildren(predicate)) {
+        subtrees.push_back(child);
+    }
+    for (int depth = 0; depth < MaxSplitDepth && subtrees.size() < minSubtrees; ++depth) {
+        std::vector<UsdPrim> children;
+        for (const UsdPrim &prim : subtrees) {
+            if (matches(prim)) {
+                results.push_back(prim.GetPath());
+            }
+            for (const UsdPrim &child : prim.GetFilteredChildren(predicate)) {
+                children.push_back(child);
+            }
+        }
+        subtrees.swap(children);
+    }
+    std::vector<std::unique_ptr<SubtreeCursor>> cursors;
+    for (const UsdPrim &prim : subtrees) {
+        cursors.emplace_back(new SubtreeCursor(prim, predicate));
+    }
+    return cursors;
+}
+
+SdfPathVector AddAncestorPaths(const SdfPathVector &matches) {
+    std::unordered_set<SdfPath, SdfPath::Hash> ancestors;
+    for (const SdfPath &path : matches) {
+        for (SdfPath parent = path.GetParentPath(); !parent.IsAbsoluteRootPath() && !parent.IsEmpty();
+             parent = parent.GetParentPath()) {
+            if (!ancestors.insert(parent).second) {
+                break; // its own ancestors were already added
+            }
+        }
+    }
+    SdfPathVector results(matches);
+    for (const SdfPath &path : ancestors) {
+        if (!std::binary_search(matches.begin(), matches.end(), path)) {
+            results.push_back(path);
+        }
+    }
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+void PrimSearch::_Search(SearchTask *task, std::mutex *stageMutex) {
+    std::vector<std::unique_ptr<SubtreeCursor>> cursors;
+    SdfPathVector results;
+    SdfPathVector allResults; // kept until the end when the ancestors are added
+    bool restart = true;
+    while (!task->cancelled) {
+        std::vector<SubtreeCursor *> activeCursors;
+        {
+            std::lock_guard<std::mutex> stageLock(*stageMutex);
+            // The stage was resynced between two batches, the cursors might point to deleted prims
+            if (restart || task->restart) {
+                task->restart = false;
+                restart = false;
+                results.clear();
+                allResults.clear();
+                cursors = SplitStage(task->stage, task->matches, task->predicate, results);
+                if (!task->withAncestors) {
+                    std::lock_guard<std::mutex> resultsLock(task->resultsMutex);
+                    task->newResults.clear();
+                    task->clearResults = true;
+                }
+            }
+            for (auto &cursor : cursors) {
+                if (cursor->iter != cursor->range.end()) {
+                    activeCursors.push_back(cursor.get());
+                }
+            }
+            const size_t primsPerCursor = std::max<size_t>(SearchedPrimsPerLock / std::max<size_t>(activeCursors.size(), 1), 1);
+            WorkParallelForEach(activeCursors.begin(), activeCursors.end(), [task, primsPerCursor](SubtreeCursor *cursor) {
+                for (size_t i = 0; i < primsPerCursor && cursor->iter != cursor->range.end(); ++i, ++cursor->iter) {
+                    if (task->matches(*cursor->iter)) {
+                        cursor->results.push_back(cursor->iter->GetPath());
+                    }
+                }
+            });
+        }
+        // Publish the results of the batch
+        for (SubtreeCursor *cursor : activeCursors) {
+            results.insert(results.end(), cursor->results.begin(), cursor->results.end());
+            cursor->results.clear();
+        }
+        if (task->withAncestors) {
+            allResults.insert(allResults.end(), results.begin(), results.end());
+        } else {
+            std::lock_guard<std::mutex> resultsLock(task->resultsMutex);
+            task->newResults.insert(task->newResults.end(), results.begin(), results.end());
+        }
+        results.clear();
+        if (activeCursors.empty()) {
+            break;
+        }
+        // Let the main thread modify the stage
+        std::this_thread::yield();
+    }
+    {
+        // The cursors must be released while the stage can't be modified
+        std::lock_guard<std::mutex> stageLock(*stageMutex);
+        cursors.clear();
+    }
+    if (task->withAncestors && !task->cancelled) {
+        std::sort(allResults.begin(), allResults.end());
+        SdfPathVector resultsWithAncestors = AddAncestorPaths(allResults);
+        std::lock_guard<std::mutex> resultsLock(task->resultsMutex);
+        task->newResults.swap(resultsWithAncestors);
+        task->newMatches.swap(allResults);
+        task->clearResults = true;
+    }
+    task->finished = true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+/// How a pattern is compared to the prim names
+enum class PrimNameMatch { Exact = 0, Wildcards, Regex };
+
+using PrimNameMatcher = std::function<bool(const std::string &)>;
+using PrimMatcher = std::function<bool(const UsdPrim &)>;
+
+/// Returns the sorted paths with their ancestors, up to the root prims. The paths must be sorted
+SdfPathVector AddAncestorPaths(const SdfPathVector &sortedPaths);
+
+/// Returns the function comparing the names with the pattern. An invalid regex matches nothing and the
+/// error is returned in errorMessage when it is not null
+PrimNameMatcher MakePrimNameMatcher(const std::string &pattern, PrimNameMatch match, std::string *errorMessage = nullptr);
+
+///
+/// PrimSearch finds all the prims of a stage matching a name or a prim matcher.
+/// The stage subtrees are traversed in parallel on a worker thread, in batches while holding the stage mutex
+/// like the PrimNameIndex, and the results are available while the search runs. A resync of the stage restarts
+/// the search.
+/// When the search includes the ancestors of the matching prims, to show them in a tree, the results are available
+/// only when the search is finished and replace the previous results at once.
+/// The matchers are called concurrently by multiple threads.
+///
+class PrimSearch : public TfWeakBase {
+  public:
+    PrimSearch(std::mutex &stageMutex);
+    ~PrimSearch();
+
+    /// Start a new search of the prim names, instance proxies included. The running search is cancelled
+    void Start(const UsdStageRefPtr &stage, const std::string &pattern, PrimNameMatch match);
+
+    /// Start a new search of the prims passing the predicate and the matcher. The running search is cancelled
+    void Start(const UsdStageRefPtr &stage, const PrimMatcher &matches, const Usd_PrimFlagsPredicate &predicate,
+               bool withAncestors);
+    void Cancel();
+
+    /// Retrieve the results found by the worker since the last frame, called on the main thread
+    void Update();
+
+    bool IsRunning() const { return _task != nullptr; }
+
+    /// The stage was resynced after the search finished, the results might be outdated
+    bool IsStale() const { return _isStale; }
+
+    /// Paths found, sorted once the search has finished
+    const SdfPathVector &GetResults() const { return _results; }
+
+    /// Returns false for the ancestors which are part of the results but don't match
+    bool IsMatching(const SdfPath &path) const;
+
+    const std::string &GetErrorMessage() const { return _errorMessage; }
+
+    /// Removes the results and the error
+    void Clear();
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice);
+
+  private:
+    struct SearchTask {
+        UsdStageRefPtr stage;
+        PrimMatcher matches;
+        Usd_PrimFlagsPredicate predicate;
+        bool withAncestors = false;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> restart{false};
+        std::atomic<bool> finished{false};
+        // Results waiting to be retrieved by the main thread
+        std::mutex resultsMutex;
+        SdfPathVector newResults;
+        SdfPathVector newMatches; // with the ancestors
+        bool clearResults = false;
+        std::thread thread;
+    };
+
+    static void _Search(SearchTask *task, std::mutex *stageMutex);
+
+    std::mutex &_stageMutex;
+    std::unique_ptr<SearchTask> _task;
+    std::vector<std::unique_ptr<SearchTask>> _cancelledTasks;
+    SdfPathVector _results;
+    SdfPathVector _matches; // sorted, when the results contain the ancestors
+    bool _withAncestors = false;
+    UsdStageWeakPtr _stage;
+    bool _isStale = false;
+    std::string _errorMessage;
+    TfNotice::Key _noticeKey;
+};
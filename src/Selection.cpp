@@ -1,53 +1,166 @@
 #include "Selection.h"
+#include <algorithm>
 #include <functional>
+#include <iterator>
+#include <pxr/base/tf/hash.h>
 #include <pxr/usd/sdf/attributeSpec.h>
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/usd/stage.h>
 
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
-/// At the moment we use a HdSelection for the stages but this will change as the we want to store additional states
-/// The selection implementation will move outside this header
-#include <pxr/imaging/hd/selection.h>
-
-/// Note the following bit of code might have terrible performances when selecting thousands of paths
-/// This has to be tested at some point
 namespace std {
-template <> struct hash<SdfPathVector> {
-    std::size_t operator()(SdfPathVector const &paths) const noexcept {
-        std::size_t hashValue = 0;
-        for (const auto p : paths) {
-            const auto pathHash = SdfPath::Hash{}(p);
-            hashValue = pathHash ^ (hashValue << 1);
-        }
-        return hashValue;
-    }
-};
-
 template <> struct hash<SdfSpecHandle> {
     std::size_t operator()(SdfSpecHandle const &spec) const noexcept { return hash_value(spec); }
 };
 
 } // namespace std
 
-struct StageSelection : public std::unique_ptr<HdSelection> {
-    // We store a state to know if the selection has changed between frames. Recomputing the hash is not ideal and potentially
-    // a performance killer, so it will likely change in the future
-    SelectionHash selectionHash = 0;
-    bool mustRecomputeHash = true;
+///
+/// Set of paths keeping the order of insertion, the first path is the anchor of the selection.
+/// A removed path leaves an empty slot in the vector, the vector is compacted when half of it is empty.
+///
+class OrderedPathSet {
+  public:
+    /// Returns false if the path was already in the set
+    bool Insert(const SdfPath &path) {
+        if (!_indices.emplace(path, _paths.size()).second) {
+            return false;
+        }
+        _paths.push_back(path);
+        return true;
+    }
+
+    /// Returns false if the path was not in the set
+    bool Erase(const SdfPath &path) {
+        const auto found = _indices.find(path);
+        if (found == _indices.end()) {
+            return false;
+        }
+        _paths[found->second] = SdfPath();
+        _indices.erase(found);
+        while (_first < _paths.size() && _paths[_first].IsEmpty()) {
+            ++_first;
+        }
+        if (_paths.size() > 2 * _indices.size() + 16) {
+            _Compact();
+        }
+        return true;
+    }
+
+    void Clear() {
+        _paths.clear();
+        _indices.clear();
+        _first = 0;
+    }
+
+    bool Contains(const SdfPath &path) const { return _indices.find(path) != _indices.end(); }
+    bool Empty() const { return _indices.empty(); }
+    size_t Size() const { return _indices.size(); }
+
+    /// First path inserted which is still in the set
+    SdfPath Front() const { return _first < _paths.size() ? _paths[_first] : SdfPath(); }
+
+    /// Paths in the order of insertion
+    SdfPathVector GetPaths() const {
+        SdfPathVector paths;
+        paths.reserve(_indices.size());
+        std::copy_if(_paths.begin() + _first, _paths.end(), std::back_inserter(paths),
+                     [](const SdfPath &path) { return !path.IsEmpty(); });
+        return paths;
+    }
+
+  private:
+    void _Compact() {
+        _paths = GetPaths();
+        _first = 0;
+        for (size_t i = 0; i < _paths.size(); ++i) {
+            _indices[_paths[i]] = i;
+        }
+    }
+
+    SdfPathVector _paths;
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> _indices;
+    size_t _first = 0;
 };
 
-struct Selection::SelectionData {
-    // Selection data for the layers
+struct StageSelection {
+    OrderedPathSet paths;
+    // Changed each time the selection changes, it is returned as the selection hash so knowing if the selection
+    // has changed between frames doesn't depend on the number of selected paths
+    SelectionHash generation = 0;
+};
+
+struct LayerSelection {
     // Instead of keeping selected path for the layers, we keep handles as the paths can change when the prims are renamed or
     // moved and it invalidates the selection. The handles on spec stays consistent with renaming and moving
-    std::unordered_set<SdfSpecHandle> _sdfPrimSelectionDomain;
+    std::unordered_set<SdfSpecHandle> prims;
+    std::unordered_set<SdfSpecHandle> properties;
+    // First selected specs
+    SdfSpecHandle primAnchor;
+    SdfSpecHandle propertyAnchor;
+
+    void Clear() {
+        prims.clear();
+        properties.clear();
+        primAnchor = SdfSpecHandle();
+        propertyAnchor = SdfSpecHandle();
+    }
+
+    void InsertPrim(const SdfSpecHandle &spec) {
+        if (prims.insert(spec).second && !primAnchor) {
+            primAnchor = spec;
+        }
+    }
+
+    void InsertProperty(const SdfSpecHandle &spec) {
+        if (properties.insert(spec).second && !propertyAnchor) {
+            propertyAnchor = spec;
+        }
+    }
+};
+
+// Returns the selection of owner, created if needed. The selections of the owners which were deleted are
+// removed when a new one is created
+template <typename OwnerHandleT, typename OwnerSelectionT>
+OwnerSelectionT &GetOwnerSelection(std::unordered_map<OwnerHandleT, OwnerSelectionT, TfHash> &selections,
+                                   const OwnerHandleT &owner) {
+    auto found = selections.find(owner);
+    if (found != selections.end()) {
+        return found->second;
+    }
+    for (auto it = selections.begin(); it != selections.end();) {
+        it = it->first ? std::next(it) : selections.erase(it);
+    }
+    return selections[owner];
+}
+
+template <typename OwnerHandleT, typename OwnerSelectionT>
+const OwnerSelectionT *FindOwnerSelection(const std::unordered_map<OwnerHandleT, OwnerSelectionT, TfHash> &selections,
+                                          const OwnerHandleT &owner) {
+    const auto found = selections.find(owner);
+    return found != selections.end() ? &found->second : nullptr;
+}
 
-    std::unordered_set<SdfSpecHandle> _sdfPropSelectionDomain;
+struct Selection::SelectionData {
+    // Each layer and each stage has its own selection, kept when another layer or stage becomes the current one
+    std::unordered_map<SdfLayerHandle, LayerSelection, TfHash> _layerSelections;
+    std::unordered_map<UsdStageWeakPtr, StageSelection, TfHash> _stageSelections;
+
+    // The generations are shared by the stages, two stage selections never have the same generation
+    SelectionHash _lastGeneration = 0;
 
-    // Selection data for the stages
-    // TODO: keep an anchor, basically the first selected prim, we would need a list to keep the order
-    StageSelection _stageSelection;
+    LayerSelection &GetLayerSelection(const SdfLayerHandle &layer) { return GetOwnerSelection(_layerSelections, layer); }
+    const LayerSelection *FindLayerSelection(const SdfLayerHandle &layer) const {
+        return FindOwnerSelection(_layerSelections, layer);
+    }
+    StageSelection &GetStageSelection(const UsdStageWeakPtr &stage) { return GetOwnerSelection(_stageSelections, stage); }
+    const StageSelection *FindStageSelection(const UsdStageWeakPtr &stage) const {
+        return FindOwnerSelection(_stageSelections, stage);
+    }
+    void SetChanged(StageSelection &stageSelection) { stageSelection.generation = ++_lastGeneration; }
 };
 
 Selection::Selection() { _data = new SelectionData(); }
@@ -57,24 +170,28 @@ Selection::~Selection() { delete _data; }
 template <> void Selection::Clear(const SdfLayerRefPtr &layer) {
     if (!_data || !layer)
         return;
-    _data->_sdfPrimSelectionDomain.clear();
+    _data->GetLayerSelection(layer).Clear();
 }
 
 template <> void Selection::Clear(const UsdStageRefPtr &stage) {
     if (!_data || !stage)
         return;
-    _data->_stageSelection.reset(new HdSelection());
-    _data->_stageSelection.mustRecomputeHash = true;
+    StageSelection &stageSelection = _data->GetStageSelection(stage);
+    if (stageSelection.paths.Empty())
+        return;
+    stageSelection.paths.Clear();
+    _data->SetChanged(stageSelection);
 }
 
 // Layer add a selection
 template <> void Selection::AddSelected(const SdfLayerRefPtr &layer, const SdfPath &selectedPath) {
     if (!_data || !layer)
         return;
+    LayerSelection &layerSelection = _data->GetLayerSelection(layer);
     if (selectedPath.IsPropertyPath()) {
-        _data->_sdfPropSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));
+        layerSelection.InsertProperty(layer->GetObjectAtPath(selectedPath));
     } else {
-        _data->_sdfPrimSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));
+        layerSelection.InsertPrim(layer->GetObjectAtPath(selectedPath));
     }
 }
 
@@ -82,33 +199,56 @@ template <> void Selection::AddSelected(const SdfLayerRefPtr &layer, const SdfPa
     template <> void Selection::AddSelected(const StageT &stage, const SdfPath &selectedPath) {                                  \
         if (!_data || !stage)                                                                                                    \
             return;                                                                                                              \
-        if (!_data->_stageSelection) {                                                                                           \
-            _data->_stageSelection.reset(new HdSelection());                                                                     \
+        StageSelection &stageSelection = _data->GetStageSelection(stage);                                                        \
+        if (stageSelection.paths.Insert(selectedPath)) {                                                                         \
+            _data->SetChanged(stageSelection);                                                                                   \
         }                                                                                                                        \
-        _data->_stageSelection->AddRprim(HdSelection::HighlightModeSelect, selectedPath);                                        \
-        _data->_stageSelection.mustRecomputeHash = true;                                                                         \
     }
 
 ImplementStageAddSelected(UsdStageRefPtr);
 ImplementStageAddSelected(UsdStageWeakPtr);
 
-// Not called at the moment
-template <> void Selection::RemoveSelected(const UsdStageWeakPtr &stage, const SdfPath &path) {
-    if (!_data || !stage)
-        return;
-}
+#define ImplementStageAddSelectedPaths(StageT)                                                                                   \
+    template <> void Selection::AddSelected(const StageT &stage, const SdfPathVector &selectedPaths) {                           \
+        if (!_data || !stage)                                                                                                    \
+            return;                                                                                                              \
+        StageSelection &stageSelection = _data->GetStageSelection(stage);                                                        \
+        bool hasChanged = false;                                                                                                 \
+        for (const SdfPath &path : selectedPaths) {                                                                              \
+            hasChanged |= stageSelection.paths.Insert(path);                                                                     \
+        }                                                                                                                        \
+        if (hasChanged) {                                                                                                        \
+            _data->SetChanged(stageSelection);                                                                                   \
+        }                                                                                                                        \
+    }
+
+ImplementStageAddSelectedPaths(UsdStageRefPtr);
+ImplementStageAddSelectedPaths(UsdStageWeakPtr);
+
+#define ImplementStageRemoveSelected(StageT)                                                                                     \
+    template <> void Selection::RemoveSelected(const StageT &stage, const SdfPath &path) {                                       \
+        if (!_data || !stage)                                                                                                    \
+            return;                                                                                                              \
+        StageSelection &stageSelection = _data->GetStageSelection(stage);                                                        \
+        if (stageSelection.paths.Erase(path)) {                                                                                  \
+            _data->SetChanged(stageSelection);                                                                                   \
+        }                                                                                                                        \
+    }
+
+ImplementStageRemoveSelected(UsdStageRefPtr);
+ImplementStageRemoveSelected(UsdStageWeakPtr);
 
 #define ImplementLayerSetSelected(LayerT)                                                                                        \
     template <> void Selection::SetSelected(const LayerT &layer, const SdfPath &selectedPath) {                                  \
         if (!_data || !layer)                                                                                                    \
             return;                                                                                                              \
-        _data->_sdfPrimSelectionDomain.clear();                                                                                  \
-        _data->_sdfPropSelectionDomain.clear();                                                                                  \
+        LayerSelection &layerSelection = _data->GetLayerSelection(layer);                                                        \
+        layerSelection.Clear();                                                                                                  \
         if (selectedPath.IsPropertyPath()) {                                                                                     \
-            _data->_sdfPropSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));                                         \
-            _data->_sdfPrimSelectionDomain.insert(layer->GetObjectAtPath(selectedPath.GetPrimOrPrimVariantSelectionPath()));     \
+            layerSelection.InsertProperty(layer->GetObjectAtPath(selectedPath));                                                 \
+            layerSelection.InsertPrim(layer->GetObjectAtPath(selectedPath.GetPrimOrPrimVariantSelectionPath()));                 \
         } else {                                                                                                                 \
-            _data->_sdfPrimSelectionDomain.insert(layer->GetObjectAtPath(selectedPath));                                         \
+            layerSelection.InsertPrim(layer->GetObjectAtPath(selectedPath));                                                     \
         }                                                                                                                        \
     }
 
@@ -119,19 +259,39 @@ ImplementLayerSetSelected(SdfLayerHandle);
     template <> void Selection::SetSelected(const StageT &stage, const SdfPath &selectedPath) {                                  \
         if (!_data || !stage)                                                                                                    \
             return;                                                                                                              \
-        _data->_stageSelection.reset(new HdSelection());                                                                         \
-        _data->_stageSelection->AddRprim(HdSelection::HighlightModeSelect, selectedPath);                                        \
-        _data->_stageSelection.mustRecomputeHash = true;                                                                         \
+        StageSelection &stageSelection = _data->GetStageSelection(stage);                                                        \
+        OrderedPathSet &paths = stageSelection.paths;                                                                            \
+        if (paths.Size() == 1 && paths.Contains(selectedPath))                                                                   \
+            return;                                                                                                              \
+        paths.Clear();                                                                                                           \
+        paths.Insert(selectedPath);                                                                                              \
+        _data->SetChanged(stageSelection);                                                                                       \
     }
 
 ImplementStageSetSelected(UsdStageRefPtr);
 ImplementStageSetSelected(UsdStageWeakPtr);
 
+#define ImplementStageSetSelectedPaths(StageT)                                                                                   \
+    template <> void Selection::SetSelected(const StageT &stage, const SdfPathVector &selectedPaths) {                           \
+        if (!_data || !stage)                                                                                                    \
+            return;                                                                                                              \
+        StageSelection &stageSelection = _data->GetStageSelection(stage);                                                        \
+        stageSelection.paths.Clear();                                                                                            \
+        for (const SdfPath &path : selectedPaths) {                                                                              \
+            stageSelection.paths.Insert(path);                                                                                   \
+        }                                                                                                                        \
+        _data->SetChanged(stageSelection);                                                                                       \
+    }
+
+ImplementStageSetSelectedPaths(UsdStageRefPtr);
+ImplementStageSetSelectedPaths(UsdStageWeakPtr);
+
 #define ImplementLayerIsSelectionEmpty(LayerT)                                                                                   \
     template <> bool Selection::IsSelectionEmpty(const LayerT &layer) const {                                                    \
         if (!_data || !layer)                                                                                                    \
             return true;                                                                                                         \
-        return _data->_sdfPrimSelectionDomain.empty() && _data->_sdfPropSelectionDomain.empty();                                 \
+        const LayerSelection *layerSelection = _data->FindLayerSelection(layer);                                                 \
+        return !layerSelection || (layerSelection->prims.empty() && layerSelection->properties.empty());                         \
     }
 
 ImplementLayerIsSelectionEmpty(SdfLayerHandle);
@@ -141,7 +301,8 @@ ImplementLayerIsSelectionEmpty(SdfLayerRefPtr);
     template <> bool Selection::IsSelectionEmpty(const StageT &stage) const {                                                    \
         if (!_data || !stage)                                                                                                    \
             return true;                                                                                                         \
-        return !_data->_stageSelection || _data->_stageSelection->IsEmpty();                                                     \
+        const StageSelection *stageSelection = _data->FindStageSelection(stage);                                                 \
+        return !stageSelection || stageSelection->paths.Empty();                                                                 \
     }
 
 ImplementStageIsSelectionEmpty(UsdStageRefPtr);
@@ -150,51 +311,48 @@ ImplementStageIsSelectionEmpty(UsdStageWeakPtr);
 template <> bool Selection::IsSelected(const SdfPrimSpecHandle &spec) const {
     if (!_data || !spec)
         return false;
-    return _data->_sdfPrimSelectionDomain.find(spec) != _data->_sdfPrimSelectionDomain.end();
+    const LayerSelection *layerSelection = _data->FindLayerSelection(spec->GetLayer());
+    return layerSelection && layerSelection->prims.find(spec) != layerSelection->prims.end();
 }
 
 template <> bool Selection::IsSelected(const SdfAttributeSpecHandle &spec) const {
     if (!_data || !spec)
         return false;
-    return _data->_sdfPropSelectionDomain.find(spec) != _data->_sdfPropSelectionDomain.end();
+    const LayerSelection *layerSelection = _data->FindLayerSelection(spec->GetLayer());
+    return layerSelection && layerSelection->properties.find(spec) != layerSelection->properties.end();
 }
 
-template <> bool Selection::IsSelected(const UsdStageWeakPtr &stage, const SdfPath &selectedPath) const {
-    if (!_data || !stage)
-        return false;
-    if (_data->_stageSelection) {
-        if (_data->_stageSelection->GetPrimSelectionState(HdSelection::HighlightModeSelect, selectedPath)) {
-            return true;
-        }
+#define ImplementStageIsSelected(StageT)                                                                                         \
+    template <> bool Selection::IsSelected(const StageT &stage, const SdfPath &selectedPath) const {                             \
+        if (!_data || !stage)                                                                                                    \
+            return false;                                                                                                        \
+        const StageSelection *stageSelection = _data->FindStageSelection(stage);                                                 \
+        return stageSelection && stageSelection->paths.Contains(selectedPath);                                                   \
     }
-    return false;
-}
+
+ImplementStageIsSelected(UsdStageRefPtr);
+ImplementStageIsSelected(UsdStageWeakPtr);
 
 template <> bool Selection::UpdateSelectionHash(const UsdStageRefPtr &stage, SelectionHash &lastSelectionHash) {
     if (!_data || !stage)
         return false;
 
-    if (_data->_stageSelection && _data->_stageSelection.mustRecomputeHash) {
-        auto paths = _data->_stageSelection->GetAllSelectedPrimPaths();
-        _data->_stageSelection.selectionHash = std::hash<SdfPathVector>{}(paths);
-    }
-
-    if (_data->_stageSelection.selectionHash != lastSelectionHash) {
-        lastSelectionHash = _data->_stageSelection.selectionHash;
+    const StageSelection *stageSelection = _data->FindStageSelection(stage);
+    const SelectionHash generation = stageSelection ? stageSelection->generation : 0;
+    if (generation != lastSelectionHash) {
+        lastSelectionHash = generation;
         return true;
     }
     return false;
 }
-// TODO: store anchor for prim and property
+
 #define ImplementGetAnchorPrimPath(LayerT)\
 template <> SdfPath Selection::GetAnchorPrimPath(const LayerT &layer) const {\
     if (!_data || !layer)\
         return {};\
-    if (!_data->_sdfPrimSelectionDomain.empty()) {\
-        const auto firstPrimHandle = *_data->_sdfPrimSelectionDomain.begin();\
-        if (firstPrimHandle) {\
-            return firstPrimHandle->GetPath();\
-        }\
+    const LayerSelection *layerSelection = _data->FindLayerSelection(layer);\
+    if (layerSelection && layerSelection->primAnchor) {\
+        return layerSelection->primAnchor->GetPath();\
     }\
     return {};\
 }\
@@ -206,11 +364,9 @@ ImplementGetAnchorPrimPath(SdfLayerRefPtr);
 template <> SdfPath Selection::GetAnchorPropertyPath(const LayerT &layer) const {\
     if (!_data || !layer)\
         return {};\
-    if (!_data->_sdfPropSelectionDomain.empty()) {\
-        const   auto firstPrimHandle = *_data->_sdfPropSelectionDomain.begin();\
-        if (firstPrimHandle) {\
-            return firstPrimHandle->GetPath();\
-        }\
+    const LayerSelection *layerSelection = _data->FindLayerSelection(layer);\
+    if (layerSelection && layerSelection->propertyAnchor) {\
+        return layerSelection->propertyAnchor->GetPath();\
     }\
     return {};\
 }\
@@ -219,26 +375,25 @@ ImplementGetAnchorPropertyPath(SdfLayerHandle);
 ImplementGetAnchorPropertyPath(SdfLayerRefPtr);
 
 
+// The anchor is the first selected path
 template <> SdfPath Selection::GetAnchorPrimPath(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
         return {};
-    if (_data->_stageSelection) {
-        const auto &paths = _data->_stageSelection->GetSelectedPrimPaths(HdSelection::HighlightModeSelect);
-        if (!paths.empty()) {
-            return paths[0];
-        }
-    }
-    return {};
+    const StageSelection *stageSelection = _data->FindStageSelection(stage);
+    return stageSelection ? stageSelection->paths.Front() : SdfPath();
 }
 
 // This is called only once when there is a drag and drop at the moment
 template <> std::vector<SdfPath> Selection::GetSelectedPaths(const SdfLayerHandle &layer) const {
     if (!_data || !layer)
         return {};
+    const LayerSelection *layerSelection = _data->FindLayerSelection(layer);
+    if (!layerSelection)
+        return {};
     std::vector<SdfPath> paths;
-    std::transform(_data->_sdfPrimSelectionDomain.begin(), _data->_sdfPrimSelectionDomain.end(), std::back_inserter(paths),
+    std::transform(layerSelection->prims.begin(), layerSelection->prims.end(), std::back_inserter(paths),
                    [](const SdfSpecHandle &p) { return p->GetPath(); });
-    std::transform(_data->_sdfPropSelectionDomain.begin(), _data->_sdfPropSelectionDomain.end(), std::back_inserter(paths),
+    std::transform(layerSelection->properties.begin(), layerSelection->properties.end(), std::back_inserter(paths),
                    [](const SdfSpecHandle &p) { return p->GetPath(); });
     return paths;
 }
@@ -246,8 +401,6 @@ template <> std::vector<SdfPath> Selection::GetSelectedPaths(const SdfLayerHandl
 template <> std::vector<SdfPath> Selection::GetSelectedPaths(const UsdStageRefPtr &stage) const {
     if (!_data || !stage)
         return {};
-    if (_data->_stageSelection) {
-        return _data->_stageSelection->GetAllSelectedPrimPaths();
-    }
-    return {};
+    const StageSelection *stageSelection = _data->FindStageSelection(stage);
+    return stageSelection ? stageSelection->paths.GetPaths() : SdfPathVector();
 }
@@ -18,14 +18,16 @@ struct Selection {
     Selection();
     ~Selection();
 
-    // The selections are store by Owners which are Layers or Stages, meaning each layer should have its own selection
-    // at some point. The API allows it, the code doesn't yet.
+    // The selections are store by Owners which are Layers or Stages, each layer and each stage has its own selection.
     // An Item is a combination of a Owner + SdfPath. If the stage is the Owner, then the Item is a UsdPrim
 
     template <typename OwnerT> void Clear(const OwnerT &);
     template <typename OwnerT> void AddSelected(const OwnerT &, const SdfPath &path);
     template <typename OwnerT> void RemoveSelected(const OwnerT &, const SdfPath &path);
     template <typename OwnerT> void SetSelected(const OwnerT &, const SdfPath &path);
+    // Bulk versions, the selection is modified once for all the paths
+    template <typename OwnerT> void AddSelected(const OwnerT &, const SdfPathVector &paths);
+    template <typename OwnerT> void SetSelected(const OwnerT &, const SdfPathVector &paths);
     template <typename OwnerT> bool IsSelectionEmpty(const OwnerT &) const;
     template <typename OwnerT> bool IsSelected(const OwnerT &, const SdfPath &path) const;
     template <typename ItemT> bool IsSelected(const ItemT &) const;
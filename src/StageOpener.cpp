@@ -0,0 +1,135 @@
+#include <algorithm>
+#include "StageOpener.h"
+
+// The payloads are loaded in this number of batches, the progress and the cancellation are checked between them
+static constexpr size_t PayloadBatchCount = 100;
+
+StageOpener::StageOpener(std::mutex &stageMutex) : _stageMutex(stageMutex) {
+    _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &StageOpener::OnLayerDidReadContent);
+}
+
+StageOpener::~StageOpener() {
+    TfNotice::Revoke(_noticeKey);
+    Cancel();
+    if (_task) {
+        _task->thread.join();
+    }
+}
+
+void StageOpener::Start(const std::string &path, PayloadLoading payloadLoading) {
+    std::unique_ptr<OpenTask> task(new OpenTask());
+    task->path = path;
+    task->payloadLoading = payloadLoading;
+    _waiting.push_back(std::move(task));
+    if (!_task) {
+        _StartNext();
+    }
+}
+
+void StageOpener::Start(const SdfLayerRefPtr &rootLayer, const SdfLayerRefPtr &sessionLayer,
+                        const ArResolverContext &resolverContext, const UsdStagePopulationMask &populationMask,
+                        const SdfPathSet &loadSet) {
+    if (!rootLayer) {
+        return;
+    }
+    std::unique_ptr<OpenTask> task(new OpenTask());
+    task->path = rootLayer->GetIdentifier();
+    task->payloadLoading = PayloadLoading::None;
+    task->rootLayer = rootLayer;
+    task->sessionLayer = sessionLayer;
+    task->resolverContext = resolverContext;
+    task->populationMask = populationMask;
+    task->loadSet = loadSet;
+    task->stageMutex = &_stageMutex;
+    _waiting.push_back(std::move(task));
+    if (!_task) {
+        _StartNext();
+    }
+}
+
+void StageOpener::_StartNext() {
+    if (_waiting.empty()) {
+        return;
+    }
+    _task = std::move(_waiting.front());
+    _waiting.pop_front();
+    _path = _task->path;
+    _layersRead = 0;
+    _task->thread = std::thread(&StageOpener::_Open, _task.get());
+}
+
+void StageOpener::Cancel() {
+    _waiting.clear();
+    if (_task) {
+        _task->cancelled = true;
+    }
+}
+
+// The task is joined only when it has finished, the main thread must not wait for UsdStage::Open
+UsdStageRefPtr StageOpener::Update(std::string &openedPath, PayloadLoading &payloadLoading) {
+    if (!_task || !_task->finished) {
+        return UsdStageRefPtr();
+    }
+    _task->thread.join();
+    UsdStageRefPtr stage = _task->cancelled ? UsdStageRefPtr() : _task->stage;
+    openedPath = _task->path;
+    payloadLoading = _task->payloadLoading;
+    _task.reset();
+    _StartNext();
+    return stage;
+}
+
+// Called by the threads reading the layers
+void StageOpener::OnLayerDidReadContent(const SdfNotice::LayerDidReadContent &notice) { _layersRead++; }
+
+// The stage mutex is held for each batch, when the task has one
+void StageOpener::_LoadPayloads(OpenTask *task, const UsdStageRefPtr &stage, const SdfPathSet &paths, UsdLoadPolicy policy) {
+    task->payloadCount = paths.size();
+    const size_t batchSize = std::max<size_t>(1, paths.size() / PayloadBatchCount);
+    SdfPathSet batch;
+    for (auto it = paths.begin(); it != paths.end() && !task->cancelled;) {
+        batch.clear();
+        for (size_t i = 0; i < batchSize && it != paths.end(); ++i, ++it) {
+            batch.insert(*it);
+        }
+        std::unique_lock<std::mutex> lock;
+        if (task->stageMutex) {
+            lock = std::unique_lock<std::mutex>(*task->stageMutex);
+        }
+        stage->LoadAndUnload(batch, SdfPathSet(), policy);
+        task->payloadsLoaded += batch.size();
+    }
+}
+
+void StageOpener::_Open(OpenTask *task) {
+    UsdStageRefPtr stage;
+    SdfPathSet loadSet;
+    if (task->rootLayer) {
+        std::lock_guard<std::mutex> lock(*task->stageMutex);
+        stage = UsdStage::OpenMasked(task->rootLayer, task->sessionLayer, task->resolverContext, task->populationMask,
+                                     UsdStage::LoadNone);
+        // The payloads loaded in the stage of the subset, outside of the population mask they don't have a prim
+        for (const SdfPath &path : task->loadSet) {
+            if (stage && stage->GetPrimAtPath(path)) {
+                loadSet.insert(path);
+            }
+        }
+    } else {
+        stage = UsdStage::Open(task->path, UsdStage::LoadNone);
+    }
+    if (stage && !loadSet.empty() && !task->cancelled) {
+        _LoadPayloads(task, stage, loadSet, UsdLoadWithoutDescendants);
+    }
+    if (stage && task->payloadLoading == PayloadLoading::All && !task->cancelled) {
+        _LoadPayloads(task, stage, stage->FindLoadable(), UsdLoadWithDescendants);
+    }
+    if (task->cancelled) {
+        std::unique_lock<std::mutex> lock;
+        if (task->stageMutex) {
+            lock = std::unique_lock<std::mutex>(*task->stageMutex);
+        }
+        stage = UsdStageRefPtr(); // released on the worker, it can take a while
+    }
+    task->stage = stage;
+    task->finished = true;
+}
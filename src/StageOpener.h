@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/ar/resolverContext.h>
+#include <pxr/usd/sdf/notice.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/stagePopulationMask.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+/// How the payloads of a stage are loaded when it is opened, the progressive modes load them after the stage is opened
+enum class PayloadLoading { All = 0, None, ClosestToCameraFirst, OutlinerRowsFirst };
+
+///
+/// StageOpener opens a stage on a worker thread. The layers are read and the stage is composed without its payloads,
+/// then the payloads are loaded in batches when they are all loaded at opening, so the progress can be reported and the
+/// opening cancelled between the batches. The stages are opened one after the other, each one is returned by Update once it is ready, it is not
+/// shared with the rest of the editor before.
+/// The editor shows a modal dialog while a stage is opening, the layers read by the worker can't be edited.
+/// A subset of an opened stage shares its layers with it, the worker holds the stage mutex while it composes the
+/// subset and loads each batch of its payloads, so the commands don't edit the layers and notify the stage meanwhile.
+///
+class StageOpener : public TfWeakBase {
+  public:
+    StageOpener(std::mutex &stageMutex);
+    ~StageOpener();
+
+    /// Open the stage of the root layer path after the stages already opening
+    void Start(const std::string &path, PayloadLoading payloadLoading);
+
+    /// Open a stage composing only the prims in the population mask, with the layers and the resolver context of
+    /// an opened stage. Only the payloads in loadSet are loaded, the descendants of a loaded payload are not
+    void Start(const SdfLayerRefPtr &rootLayer, const SdfLayerRefPtr &sessionLayer, const ArResolverContext &resolverContext,
+               const UsdStagePopulationMask &populationMask, const SdfPathSet &loadSet);
+
+    /// The worker stops at the next batch of payloads and the stages waiting are discarded. The stage is opening until
+    /// the worker has stopped, UsdStage::Open can't be interrupted
+    void Cancel();
+
+    /// Returns a stage when it is ready, once, with the path and the payload loading it was opened with, and start
+    /// opening the next one. Called on the main thread
+    UsdStageRefPtr Update(std::string &openedPath, PayloadLoading &payloadLoading);
+
+    bool IsOpening() const { return _task != nullptr; }
+    size_t GetWaitingCount() const { return _waiting.size(); }
+    bool IsCancelled() const { return _task && _task->cancelled; }
+
+    const std::string &GetPath() const { return _path; }
+    size_t GetLayersRead() const { return _layersRead; }
+    size_t GetPayloadsLoaded() const { return _task ? _task->payloadsLoaded.load() : 0; }
+    size_t GetPayloadCount() const { return _task ? _task->payloadCount.load() : 0; }
+
+    void OnLayerDidReadContent(const SdfNotice::LayerDidReadContent &notice);
+
+  private:
+    struct OpenTask {
+        std::string path;
+        PayloadLoading payloadLoading = PayloadLoading::All;
+        SdfLayerRefPtr rootLayer; // opened instead of path when set
+        SdfLayerRefPtr sessionLayer;
+        ArResolverContext resolverContext;
+        UsdStagePopulationMask populationMask = UsdStagePopulationMask::All();
+        SdfPathSet loadSet; // loaded with the payload loading None
+        std::mutex *stageMutex = nullptr; // locked by the worker when the layers are shared with an opened stage
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> finished{false};
+        std::atomic<size_t> payloadsLoaded{0};
+        std::atomic<size_t> payloadCount{0};
+        UsdStageRefPtr stage; // Written by the worker before it has finished
+        std::thread thread;
+    };
+
+    static void _Open(OpenTask *task);
+    static void _LoadPayloads(OpenTask *task, const UsdStageRefPtr &stage, const SdfPathSet &paths, UsdLoadPolicy policy);
+    void _StartNext();
+
+    std::mutex &_stageMutex;
+    std::unique_ptr<OpenTask> _task;
+    std::deque<std::unique_ptr<OpenTask>> _waiting; // not started yet
+    std::string _path;
+    std::atomic<size_t> _layersRead{0}; // by all the threads since the start
+    TfNotice::Key _noticeKey;
+};
@@ -20,6 +20,9 @@ struct AttributeSet : public SdfLayerCommand {
 
     ~AttributeSet() override {}
 
+    // Uses the Usd api which needs an up to date stage
+    bool EditsSdfOnly() const override { return false; }
+
     bool DoIt() override {
         if (_stage) {
             auto layer = _stage->GetEditTarget().GetLayer();
@@ -48,6 +51,9 @@ struct AttributeCreateDefaultValue : public SdfLayerCommand {
 
     ~AttributeCreateDefaultValue() override {}
 
+    // Uses the Usd api which needs an up to date stage
+    bool EditsSdfOnly() const override { return false; }
+
     bool DoIt() override {
         if (_stage) {
             auto layer = _stage->GetEditTarget().GetLayer();
@@ -78,6 +84,9 @@ struct AttributeConnect : public SdfLayerCommand {
     AttributeConnect(UsdStageWeakPtr stage, SdfPath tail, SdfPath head) :
     _stage(stage), _head(head), _tail(tail) {}
     
+    // Uses the Usd api which needs an up to date stage
+    bool EditsSdfOnly() const override { return false; }
+
     bool DoIt() override {
         if (_stage) {
             auto layer = _stage->GetEditTarget().GetLayer();
@@ -102,6 +111,9 @@ struct RelationshipReplace : public SdfLayerCommand {
     RelationshipReplace(UsdRelationship rel, SdfPath before, SdfPath after) :
     _rel(rel), _before(before), _after(after){}
     
+    // Uses the Usd api which needs an up to date stage
+    bool EditsSdfOnly() const override { return false; }
+
     bool DoIt() override {
         if (_rel) {
             auto layer = _rel.GetStage()->GetEditTarget().GetLayer();
@@ -1,5 +1,6 @@
 #include "CommandStack.h"
 #include "SdfCommandGroupRecorder.h"
+#include <pxr/usd/sdf/changeBlock.h>
 
 CommandStack *CommandStack::instance = nullptr;
 
@@ -18,22 +19,59 @@ CommandStack::~CommandStack() {
 }
 
 void CommandStack::ExecuteCommands() {
-    if (lastCmd) {
-        if (lastCmd->DoIt()) {
-            _PushCommand(lastCmd);
+    // Commands posted while executing the queue will run on the next frame
+    std::deque<Command *> commands;
+    commands.swap(commandQueue);
+
+    // Consecutive commands editing only the Sdf data share the same change block, so a burst of edits
+    // triggers only one recomposition. The Usd api is not safe inside a SdfChangeBlock, so the block is
+    // closed before running a command that needs an up to date stage.
+    std::unique_ptr<SdfChangeBlock> changeBlock;
+    for (Command *command : commands) {
+        if (command->EditsSdfOnly()) {
+            if (!changeBlock) {
+                changeBlock.reset(new SdfChangeBlock());
+            }
         } else {
-            delete lastCmd;
+            changeBlock.reset();
+        }
+        if (command->DoIt()) {
+            _PushCommand(command);
+        } else {
+            delete command;
         }
-        lastCmd = nullptr; // Reset the command
     }
 }
 
 void CommandStack::_PushCommand(Command *cmd) {
     if (undoStackPos != undoStack.size()) {
+        for (auto memorySize = undoStackMemorySizes.begin() + undoStackPos; memorySize != undoStackMemorySizes.end();
+             ++memorySize) {
+            undoStackMemorySize -= *memorySize;
+        }
         undoStack.resize(undoStackPos);
+        undoStackMemorySizes.resize(undoStackPos);
     }
+    undoStackMemorySizes.push_back(cmd->GetMemorySize());
+    undoStackMemorySize += undoStackMemorySizes.back();
     undoStack.emplace_back(std::move(cmd));
     undoStackPos++;
+    _EvictOldestCommands();
+}
+
+void CommandStack::SetMemoryBudget(size_t budget) {
+    memoryBudget = budget;
+    _EvictOldestCommands();
+}
+
+void CommandStack::_EvictOldestCommands() {
+    // We always keep the last command so it can be undone, even if it doesn't fit in the budget
+    while (memoryBudget > 0 && undoStackMemorySize > memoryBudget && undoStackPos > 1) {
+        undoStackMemorySize -= undoStackMemorySizes.front();
+        undoStackMemorySizes.pop_front();
+        undoStack.pop_front();
+        undoStackPos--;
+    }
 }
 
 struct UndoCommand : public Command {
@@ -44,6 +82,7 @@ struct UndoCommand : public Command {
     /// Undo the last command in the stack
     bool DoIt() override ;
     bool UndoIt() override { return false; }
+    bool EditsSdfOnly() const override { return true; }
 };
 
 struct RedoCommand : public Command {
@@ -54,6 +93,7 @@ struct RedoCommand : public Command {
     /// Undo the last command in the stack
     bool DoIt() override;
     bool UndoIt() override { return false; }
+    bool EditsSdfOnly() const override { return true; }
 };
 
 
@@ -99,8 +139,8 @@ bool ClearUndoRedoCommand::DoIt() {
     CommandStack &commandStack = CommandStack::GetInstance();
     commandStack.undoStackPos = 0;
     commandStack.undoStack.clear();
-    delete commandStack.lastCmd;
-    commandStack.lastCmd = nullptr;
+    commandStack.undoStackMemorySizes.clear();
+    commandStack.undoStackMemorySize = 0;
     return false; // Should never be stored in the stack
 }
 template void ExecuteAfterDraw<ClearUndoRedoCommand>();
@@ -136,3 +176,15 @@ template void ExecuteAfterDraw<UsdFunctionCall>(UsdStageRefPtr stage, std::funct
 void ExecuteCommands() {
     CommandStack::GetInstance().ExecuteCommands();
 }
+
+void SetUndoMemoryBudget(size_t memoryBudget) {
+    CommandStack::GetInstance().SetMemoryBudget(memoryBudget);
+}
+
+size_t GetUndoMemoryBudget() {
+    return CommandStack::GetInstance().GetMemoryBudget();
+}
+
+size_t GetUndoMemorySize() {
+    return CommandStack::GetInstance().GetMemorySize();
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -19,29 +20,43 @@ struct CommandStack {
     
     static CommandStack &GetInstance();
 
-    inline bool HasNextCommand() { return lastCmd != nullptr; }
-    inline void SetNextCommand(Command *command) { lastCmd = command; }
-    
-    // Execute next command and push it on the stack
+    inline bool HasNextCommand() { return !commandQueue.empty(); }
+    inline void PushNextCommand(Command *command) { commandQueue.push_back(command); }
+
+    // Execute all the commands queued during the frame and push them on the stack
     void ExecuteCommands();
+
+    /// Memory budget of the undo history in bytes, 0 means unlimited.
+    /// When the budget is exceeded, the oldest commands are dropped from the history
+    void SetMemoryBudget(size_t memoryBudget);
+    size_t GetMemoryBudget() const { return memoryBudget; }
+    size_t GetMemorySize() const { return undoStackMemorySize; }
     
 private:
 
 
     // The undo stack should ultimately belong to an Editor, not be a global variable
-    using UndoStackT = std::vector<std::unique_ptr<Command>>;
+    using UndoStackT = std::deque<std::unique_ptr<Command>>;
     UndoStackT undoStack;
 
+    /// Memory size of each command in the undo stack, computed when the command is pushed
+    std::deque<size_t> undoStackMemorySizes;
+    size_t undoStackMemorySize = 0;
+    size_t memoryBudget = 0;
+
     /// The pointer to the current command in the undo stack
     int undoStackPos = 0;
 
-    // Storing only one command per frame for now, easier to reason about.
-    Command *lastCmd = nullptr;
+    /// Commands posted during the frame, executed in order by ExecuteCommands
+    std::deque<Command *> commandQueue;
 
     /// The ProcessCommands function is called after the frame is rendered and displayed and execute the
-    /// last command. The command passed here now belongs to this stack
+    /// queued commands. The command passed here now belongs to this stack
     void _PushCommand(Command *cmd);
 
+    /// Drop the oldest commands until the undo history fits in the memory budget
+    void _EvictOldestCommands();
+
   private:
     CommandStack();
     ~CommandStack();
@@ -51,7 +66,5 @@ private:
 /// Dispatching Commands.
 template <typename CommandClass, typename... ArgTypes> void ExecuteAfterDraw(ArgTypes... arguments) {
     CommandStack &commandStack = CommandStack::GetInstance();
-    if (!commandStack.HasNextCommand()) {
-        commandStack.SetNextCommand(new CommandClass(arguments...));
-    }
+    commandStack.PushNextCommand(new CommandClass(arguments...));
 }
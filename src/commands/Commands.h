@@ -7,6 +7,7 @@
 #include <pxr/usd/usdGeom/xformCommonAPI.h>
 #include <pxr/usd/usdGeom/camera.h>
 #include <functional>
+#include <mutex>
 #include <tuple>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -37,17 +38,24 @@ struct PropertyPaste;
 
 struct EditorSetDataPointer;
 struct EditorOpenStage;
+struct EditorOpenStageSubset;
+struct EditorAddToPopulationMask;
+struct EditorRemoveFromPopulationMask;
+struct EditorExpandPopulationMask;
 struct EditorFindOrOpenLayer;
 struct EditorRunLauncher;
 struct EditorAddLauncher;
 struct EditorRemoveLauncher;
 struct EditorSaveLayerAs;
+struct EditorSaveLayer;
 struct EditorSetCurrentLayer;
 struct EditorSetCurrentStage;
 struct EditorSetEditTarget;
 struct EditorSetPreviousLayer;
 struct EditorSetNextLayer;
 struct EditorSetSelection;
+struct EditorSelectPaths;
+struct EditorSelectDescendants;
 struct EditorSelectAttributePath;
 struct EditorShutdown;
 struct EditorStartPlayback;
@@ -57,6 +65,7 @@ struct EditorFindPrim;
 struct EditorExportUsdz;
 struct EditorExportFlattenedStage;
 struct EditorScaleUI;
+struct EditorSetUndoMemoryBudget;
 
 struct LayerRemoveSubLayer;
 struct LayerMoveSubLayer;
@@ -239,9 +248,15 @@ void ExecuteAfterDraw(FuncT &&func, const UsdGeomXformCommonAPI &api, ArgsT &&..
 //// We could simply copy the handle/ref/weak/ptrs
 
 
-/// Process the commands waiting in the queue. Only one command would be waiting at the moment
+/// Process the commands waiting in the queue, in the order they were posted
 void ExecuteCommands();
 
+/// Memory used by the undo history, in bytes. When the budget is exceeded the oldest commands are dropped.
+/// A budget of 0 means unlimited
+void SetUndoMemoryBudget(size_t memoryBudget);
+size_t GetUndoMemoryBudget();
+size_t GetUndoMemorySize();
+
 ///
 /// Allows to record one command spanning multiple frames.
 /// It is used in the manipulators, to record only one command for a translation/rotation etc.
@@ -249,3 +264,10 @@ void ExecuteCommands();
 void BeginEdition(UsdStageRefPtr);
 void BeginEdition(SdfLayerRefPtr);
 void EndEdition();
+
+/// Returns true between BeginEdition and EndEdition, the state delegate of the edited layer must not be replaced
+bool IsEditionActive();
+
+/// Lock the stages read by the background tasks. The commands are executed with the stages locked, the code modifying
+/// a stage or a layer outside of a command, like the manipulators while dragging, must hold this lock
+std::unique_lock<std::mutex> LockStagesForEdition();
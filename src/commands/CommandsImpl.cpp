@@ -48,6 +48,8 @@ void EndEdition() {
     }
 }
 
+bool IsEditionActive() { return undoRedoRecorder != nullptr; }
+
 // Include all the commands as cpp files to compile them with this unit as we want to have
 // at least two implementation, one for the Editor and another for a widget library.
 // We can create a CommandsUndoRedoImpl.cpp and CommandsUndoRedoImpl.tpp later on
@@ -10,12 +10,20 @@ struct Command {
     virtual ~Command(){};
     virtual bool DoIt() = 0;
     virtual bool UndoIt() { return false; }
+
+    /// Commands only editing Sdf data can run in a SdfChangeBlock shared with the other commands of the frame
+    virtual bool EditsSdfOnly() const { return false; }
+
+    /// Approximate memory kept by the command to undo and redo its edits, in bytes
+    virtual size_t GetMemorySize() const { return 0; }
 };
 
 struct SdfLayerCommand : public Command {
     virtual ~SdfLayerCommand(){};
     virtual bool DoIt() override = 0;
     bool UndoIt() override;
+    bool EditsSdfOnly() const override { return true; }
+    size_t GetMemorySize() const override { return _undoCommands.GetMemorySize(); }
     SdfCommandGroup _undoCommands;
 };
 
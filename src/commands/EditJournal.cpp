@@ -0,0 +1,1138 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <typeindex>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/gf/matrix2d.h>
+#include <pxr/base/gf/matrix3d.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/quatd.h>
+#include <pxr/base/gf/quatf.h>
+#include <pxr/base/gf/quath.h>
+#include <pxr/base/gf/vec2d.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec2h.h>
+#include <pxr/base/gf/vec2i.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec3h.h>
+#include <pxr/base/gf/vec3i.h>
+#include <pxr/base/gf/vec4d.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/gf/vec4h.h>
+#include <pxr/base/gf/vec4i.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/base/vt/dictionary.h>
+#include <pxr/usd/sdf/assetPath.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/layerOffset.h>
+#include <pxr/usd/sdf/listOp.h>
+#include <pxr/usd/sdf/payload.h>
+#include <pxr/usd/sdf/reference.h>
+#include <pxr/usd/sdf/timeCode.h>
+#include <pxr/usd/sdf/types.h>
+#include "EditJournal.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+///
+/// Journal file layout, all the values are stored in the native byte order as the journal is only
+/// meant to be read back on the same machine:
+///   header:  magic, version, layer identifier
+///   records: uint32 size of the record, operation, arguments of the operation
+/// A record that was not completely written before a crash is ignored when the journal is replayed.
+///
+
+namespace {
+
+constexpr char journalMagic[8] = {'u', 's', 'd', 't', 'w', 'k', 'j', '\n'};
+constexpr uint32_t journalVersion = 1;
+constexpr const char *journalExtension = ".journal";
+// Bigger identifiers are read from a corrupted header
+constexpr uint32_t journalMaxIdentifierSize = 1 << 20;
+
+enum _Operation : uint8_t {
+    SetFieldOperation = 0,
+    SetFieldDictValueByKeyOperation,
+    SetTimeSampleOperation,
+    CreateSpecOperation,
+    DeleteSpecOperation,
+    MoveSpecOperation,
+    PushChildTokenOperation,
+    PushChildPathOperation,
+    PopChildTokenOperation,
+    PopChildPathOperation,
+    // Not written in the journal, it tells the worker to delete the journal
+    DiscardJournalOperation = 255
+};
+
+struct _Reader {
+    const char *cur;
+    const char *end;
+    // Set when a value has a type the journal doesn't know how to serialize
+    bool hasUnsupportedValue = false;
+
+    size_t Remaining() const { return static_cast<size_t>(end - cur); }
+    bool Read(void *dst, size_t size) {
+        if (Remaining() < size) {
+            return false;
+        }
+        memcpy(dst, cur, size);
+        cur += size;
+        return true;
+    }
+};
+
+// Declaration of all the serialization functions, the containers functions need to see all of them
+
+template <typename T> typename std::enable_if<std::is_trivially_copyable<T>::value>::type _Write(std::string &out, const T &value);
+void _Write(std::string &out, const std::string &value);
+void _Write(std::string &out, const TfToken &value);
+void _Write(std::string &out, const SdfPath &value);
+void _Write(std::string &out, const SdfAssetPath &value);
+void _Write(std::string &out, const SdfTimeCode &value);
+void _Write(std::string &out, const GfHalf &value);
+void _Write(std::string &out, const SdfLayerOffset &value);
+void _Write(std::string &out, const SdfReference &value);
+void _Write(std::string &out, const SdfPayload &value);
+void _Write(std::string &out, const VtValue &value);
+void _Write(std::string &out, const VtDictionary &value);
+void _Write(std::string &out, const SdfTimeSampleMap &value);
+void _Write(std::string &out, const SdfVariantSelectionMap &value);
+template <typename T> void _Write(std::string &out, const std::vector<T> &value);
+template <typename T> void _Write(std::string &out, const VtArray<T> &value);
+template <typename T> void _Write(std::string &out, const SdfListOp<T> &value);
+
+template <typename T> typename std::enable_if<std::is_trivially_copyable<T>::value, bool>::type _Read(_Reader &in, T &value);
+bool _Read(_Reader &in, std::string &value);
+bool _Read(_Reader &in, TfToken &value);
+bool _Read(_Reader &in, SdfPath &value);
+bool _Read(_Reader &in, SdfAssetPath &value);
+bool _Read(_Reader &in, SdfTimeCode &value);
+bool _Read(_Reader &in, GfHalf &value);
+bool _Read(_Reader &in, SdfLayerOffset &value);
+bool _Read(_Reader &in, SdfReference &value);
+bool _Read(_Reader &in, SdfPayload &value);
+bool _Read(_Reader &in, VtValue &value);
+bool _Read(_Reader &in, VtDictionary &value);
+bool _Read(_Reader &in, SdfTimeSampleMap &value);
+bool _Read(_Reader &in, SdfVariantSelectionMap &value);
+template <typename T> bool _Read(_Reader &in, std::vector<T> &value);
+template <typename T> bool _Read(_Reader &in, VtArray<T> &value);
+template <typename T> bool _Read(_Reader &in, SdfListOp<T> &value);
+
+// Plain data
+template <typename T> typename std::enable_if<std::is_trivially_copyable<T>::value>::type _Write(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> typename std::enable_if<std::is_trivially_copyable<T>::value, bool>::type _Read(_Reader &in, T &value) {
+    return in.Read(&value, sizeof(T));
+}
+
+// Strings and string based types
+void _Write(std::string &out, const std::string &value) {
+    _Write(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+bool _Read(_Reader &in, std::string &value) {
+    uint32_t size = 0;
+    if (!_Read(in, size) || in.Remaining() < size) {
+        return false;
+    }
+    value.assign(in.cur, size);
+    in.cur += size;
+    return true;
+}
+
+void _Write(std::string &out, const TfToken &value) { _Write(out, value.GetString()); }
+bool _Read(_Reader &in, TfToken &value) {
+    std::string str;
+    if (!_Read(in, str)) {
+        return false;
+    }
+    value = TfToken(str);
+    return true;
+}
+
+void _Write(std::string &out, const SdfPath &value) { _Write(out, value.GetString()); }
+bool _Read(_Reader &in, SdfPath &value) {
+    std::string str;
+    if (!_Read(in, str)) {
+        return false;
+    }
+    value = str.empty() ? SdfPath() : SdfPath(str);
+    return true;
+}
+
+void _Write(std::string &out, const SdfAssetPath &value) { _Write(out, value.GetAssetPath()); }
+bool _Read(_Reader &in, SdfAssetPath &value) {
+    std::string str;
+    if (!_Read(in, str)) {
+        return false;
+    }
+    value = SdfAssetPath(str);
+    return true;
+}
+
+void _Write(std::string &out, const SdfTimeCode &value) { _Write(out, value.GetValue()); }
+bool _Read(_Reader &in, SdfTimeCode &value) {
+    double time = 0.0;
+    if (!_Read(in, time)) {
+        return false;
+    }
+    value = SdfTimeCode(time);
+    return true;
+}
+
+void _Write(std::string &out, const GfHalf &value) { _Write(out, value.bits()); }
+bool _Read(_Reader &in, GfHalf &value) {
+    unsigned short bits = 0;
+    if (!_Read(in, bits)) {
+        return false;
+    }
+    value.setBits(bits);
+    return true;
+}
+
+// Composition arcs
+void _Write(std::string &out, const SdfLayerOffset &value) {
+    _Write(out, value.GetOffset());
+    _Write(out, value.GetScale());
+}
+
+bool _Read(_Reader &in, SdfLayerOffset &value) {
+    double offset = 0.0;
+    double scale = 1.0;
+    if (!_Read(in, offset) || !_Read(in, scale)) {
+        return false;
+    }
+    value = SdfLayerOffset(offset, scale);
+    return true;
+}
+
+void _Write(std::string &out, const SdfReference &value) {
+    _Write(out, value.GetAssetPath());
+    _Write(out, value.GetPrimPath());
+    _Write(out, value.GetLayerOffset());
+    _Write(out, value.GetCustomData());
+}
+
+bool _Read(_Reader &in, SdfReference &value) {
+    std::string assetPath;
+    SdfPath primPath;
+    SdfLayerOffset layerOffset;
+    VtDictionary customData;
+    if (!_Read(in, assetPath) || !_Read(in, primPath) || !_Read(in, layerOffset) || !_Read(in, customData)) {
+        return false;
+    }
+    value = SdfReference(assetPath, primPath, layerOffset, customData);
+    return true;
+}
+
+void _Write(std::string &out, const SdfPayload &value) {
+    _Write(out, value.GetAssetPath());
+    _Write(out, value.GetPrimPath());
+    _Write(out, value.GetLayerOffset());
+}
+
+bool _Read(_Reader &in, SdfPayload &value) {
+    std::string assetPath;
+    SdfPath primPath;
+    SdfLayerOffset layerOffset;
+    if (!_Read(in, assetPath) || !_Read(in, primPath) || !_Read(in, layerOffset)) {
+        return false;
+    }
+    value = SdfPayload(assetPath, primPath, layerOffset);
+    return true;
+}
+
+// Containers
+template <typename T> void _WriteItems(std::string &out, const T *items, size_t count, std::true_type) {
+    out.append(reinterpret_cast<const char *>(items), count * sizeof(T));
+}
+
+template <typename T> void _WriteItems(std::string &out, const T *items, size_t count, std::false_type) {
+    for (size_t i = 0; i < count; ++i) {
+        _Write(out, items[i]);
+    }
+}
+
+template <typename T> bool _ReadItems(_Reader &in, T *items, size_t count, std::true_type) {
+    return in.Read(items, count * sizeof(T));
+}
+
+template <typename T> bool _ReadItems(_Reader &in, T *items, size_t count, std::false_type) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!_Read(in, items[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T> void _Write(std::string &out, const std::vector<T> &value) {
+    _Write(out, static_cast<uint64_t>(value.size()));
+    _WriteItems(out, value.data(), value.size(), std::is_trivially_copyable<T>());
+}
+
+template <typename T> bool _Read(_Reader &in, std::vector<T> &value) {
+    uint64_t count = 0;
+    // Each item takes at least one byte, this protects against allocating a corrupted size
+    if (!_Read(in, count) || count > in.Remaining()) {
+        return false;
+    }
+    value.resize(count);
+    return _ReadItems(in, value.data(), count, std::is_trivially_copyable<T>());
+}
+
+template <typename T> void _Write(std::string &out, const VtArray<T> &value) {
+    _Write(out, static_cast<uint64_t>(value.size()));
+    _WriteItems(out, value.cdata(), value.size(), std::is_trivially_copyable<T>());
+}
+
+template <typename T> bool _Read(_Reader &in, VtArray<T> &value) {
+    uint64_t count = 0;
+    if (!_Read(in, count) || count > in.Remaining()) {
+        return false;
+    }
+    value.resize(count);
+    return _ReadItems(in, value.data(), count, std::is_trivially_copyable<T>());
+}
+
+template <typename T> void _Write(std::string &out, const SdfListOp<T> &value) {
+    _Write(out, value.IsExplicit());
+    if (value.IsExplicit()) {
+        _Write(out, value.GetExplicitItems());
+    } else {
+        _Write(out, value.GetAddedItems());
+        _Write(out, value.GetPrependedItems());
+        _Write(out, value.GetAppendedItems());
+        _Write(out, value.GetDeletedItems());
+        _Write(out, value.GetOrderedItems());
+    }
+}
+
+template <typename T> bool _Read(_Reader &in, SdfListOp<T> &value) {
+    bool isExplicit = false;
+    if (!_Read(in, isExplicit)) {
+        return false;
+    }
+    typename SdfListOp<T>::ItemVector items;
+    if (isExplicit) {
+        if (!_Read(in, items)) {
+            return false;
+        }
+        value.SetExplicitItems(items);
+        return true;
+    }
+    if (!_Read(in, items)) {
+        return false;
+    }
+    value.SetAddedItems(items);
+    if (!_Read(in, items)) {
+        return false;
+    }
+    value.SetPrependedItems(items);
+    if (!_Read(in, items)) {
+        return false;
+    }
+    value.SetAppendedItems(items);
+    if (!_Read(in, items)) {
+        return false;
+    }
+    value.SetDeletedItems(items);
+    if (!_Read(in, items)) {
+        return false;
+    }
+    value.SetOrderedItems(items);
+    return true;
+}
+
+void _Write(std::string &out, const VtDictionary &value) {
+    _Write(out, static_cast<uint64_t>(value.size()));
+    for (const auto &item : value) {
+        _Write(out, item.first);
+        _Write(out, item.second);
+    }
+}
+
+bool _Read(_Reader &in, VtDictionary &value) {
+    uint64_t count = 0;
+    if (!_Read(in, count) || count > in.Remaining()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string key;
+        VtValue item;
+        if (!_Read(in, key) || !_Read(in, item)) {
+            return false;
+        }
+        value[key] = std::move(item);
+    }
+    return true;
+}
+
+void _Write(std::string &out, const SdfTimeSampleMap &value) {
+    _Write(out, static_cast<uint64_t>(value.size()));
+    for (const auto &sample : value) {
+        _Write(out, sample.first);
+        _Write(out, sample.second);
+    }
+}
+
+bool _Read(_Reader &in, SdfTimeSampleMap &value) {
+    uint64_t count = 0;
+    if (!_Read(in, count) || count > in.Remaining()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        double time = 0.0;
+        VtValue sample;
+        if (!_Read(in, time) || !_Read(in, sample)) {
+            return false;
+        }
+        value[time] = std::move(sample);
+    }
+    return true;
+}
+
+void _Write(std::string &out, const SdfVariantSelectionMap &value) {
+    _Write(out, static_cast<uint64_t>(value.size()));
+    for (const auto &selection : value) {
+        _Write(out, selection.first);
+        _Write(out, selection.second);
+    }
+}
+
+bool _Read(_Reader &in, SdfVariantSelectionMap &value) {
+    uint64_t count = 0;
+    if (!_Read(in, count) || count > in.Remaining()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string variantSet;
+        std::string variant;
+        if (!_Read(in, variantSet) || !_Read(in, variant)) {
+            return false;
+        }
+        value[variantSet] = variant;
+    }
+    return true;
+}
+
+// Types that can be held by the VtValues of the journal: the scalar types, the arrays of scalar types and the
+// other types. The position of a type in the lists is its identifier in the files, new types must be added at
+// the end of JOURNAL_VALUE_OTHER_TYPES.
+#define JOURNAL_VALUE_SCALAR_TYPES(X)                                                                                       \
+    X(bool)                                                                                                                  \
+    X(unsigned char)                                                                                                         \
+    X(int)                                                                                                                   \
+    X(unsigned int)                                                                                                          \
+    X(int64_t)                                                                                                               \
+    X(uint64_t)                                                                                                              \
+    X(GfHalf)                                                                                                                \
+    X(float)                                                                                                                 \
+    X(double)                                                                                                                \
+    X(SdfTimeCode)                                                                                                           \
+    X(std::string)                                                                                                           \
+    X(TfToken)                                                                                                               \
+    X(SdfAssetPath)                                                                                                          \
+    X(SdfPath)                                                                                                               \
+    X(GfVec2d)                                                                                                               \
+    X(GfVec2f)                                                                                                               \
+    X(GfVec2h)                                                                                                               \
+    X(GfVec2i)                                                                                                               \
+    X(GfVec3d)                                                                                                               \
+    X(GfVec3f)                                                                                                               \
+    X(GfVec3h)                                                                                                               \
+    X(GfVec3i)                                                                                                               \
+    X(GfVec4d)                                                                                                               \
+    X(GfVec4f)                                                                                                               \
+    X(GfVec4h)                                                                                                               \
+    X(GfVec4i)                                                                                                               \
+    X(GfMatrix2d)                                                                                                            \
+    X(GfMatrix3d)                                                                                                            \
+    X(GfMatrix4d)                                                                                                            \
+    X(GfQuatd)                                                                                                               \
+    X(GfQuatf)                                                                                                               \
+    X(GfQuath)
+
+#define JOURNAL_VALUE_OTHER_TYPES(X)                                                                                        \
+    X(SdfSpecifier)                                                                                                          \
+    X(SdfVariability)                                                                                                        \
+    X(SdfPermission)                                                                                                         \
+    X(SdfSpecType)                                                                                                           \
+    X(TfTokenVector)                                                                                                         \
+    X(SdfPathVector)                                                                                                         \
+    X(std::vector<std::string>)                                                                                              \
+    X(std::vector<double>)                                                                                                   \
+    X(SdfLayerOffset)                                                                                                        \
+    X(SdfLayerOffsetVector)                                                                                                  \
+    X(VtDictionary)                                                                                                          \
+    X(SdfTimeSampleMap)                                                                                                      \
+    X(SdfVariantSelectionMap)                                                                                                \
+    X(SdfReference)                                                                                                          \
+    X(SdfPayload)                                                                                                            \
+    X(SdfTokenListOp)                                                                                                        \
+    X(SdfPathListOp)                                                                                                         \
+    X(SdfStringListOp)                                                                                                       \
+    X(SdfReferenceListOp)                                                                                                    \
+    X(SdfPayloadListOp)                                                                                                      \
+    X(SdfIntListOp)                                                                                                          \
+    X(SdfInt64ListOp)                                                                                                        \
+    X(SdfUIntListOp)                                                                                                         \
+    X(SdfUInt64ListOp)
+
+using _ValueWriter = void (*)(std::string &, const VtValue &);
+using _ValueReader = bool (*)(_Reader &, VtValue &);
+
+struct _ValueCodec {
+    std::type_index type;
+    _ValueWriter write;
+    _ValueReader read;
+};
+
+template <typename T> void _WriteValueAs(std::string &out, const VtValue &value) { _Write(out, value.UncheckedGet<T>()); }
+
+template <typename T> bool _ReadValueAs(_Reader &in, VtValue &value) {
+    T held;
+    if (!_Read(in, held)) {
+        return false;
+    }
+    value = VtValue::Take(held);
+    return true;
+}
+
+#define JOURNAL_VALUE_CODEC(T) _ValueCodec{std::type_index(typeid(T)), &_WriteValueAs<T>, &_ReadValueAs<T>},
+#define JOURNAL_VALUE_ARRAY_CODEC(T) JOURNAL_VALUE_CODEC(VtArray<T>)
+
+const std::vector<_ValueCodec> &_GetValueCodecs() {
+    static const std::vector<_ValueCodec> codecs = {JOURNAL_VALUE_SCALAR_TYPES(JOURNAL_VALUE_CODEC)
+                                                        JOURNAL_VALUE_SCALAR_TYPES(JOURNAL_VALUE_ARRAY_CODEC)
+                                                            JOURNAL_VALUE_OTHER_TYPES(JOURNAL_VALUE_CODEC)};
+    return codecs;
+}
+
+const std::unordered_map<std::type_index, uint16_t> &_GetValueCodecIndices() {
+    static const std::unordered_map<std::type_index, uint16_t> indices = []() {
+        std::unordered_map<std::type_index, uint16_t> indices;
+        const auto &codecs = _GetValueCodecs();
+        for (size_t i = 0; i < codecs.size(); ++i) {
+            indices.emplace(codecs[i].type, static_cast<uint16_t>(i));
+        }
+        return indices;
+    }();
+    return indices;
+}
+
+// Value type identifiers in the file, the codecs start after the two special values
+constexpr uint16_t emptyValueId = 0;
+constexpr uint16_t unsupportedValueId = 1;
+constexpr uint16_t firstCodecId = 2;
+
+void _Write(std::string &out, const VtValue &value) {
+    if (value.IsEmpty()) {
+        _Write(out, emptyValueId);
+        return;
+    }
+    const auto &indices = _GetValueCodecIndices();
+    const auto found = indices.find(std::type_index(value.GetTypeid()));
+    if (found == indices.end()) {
+        // The type name is kept to report it when the journal is replayed
+        _Write(out, unsupportedValueId);
+        _Write(out, value.GetTypeName());
+        return;
+    }
+    _Write(out, static_cast<uint16_t>(found->second + firstCodecId));
+    _GetValueCodecs()[found->second].write(out, value);
+}
+
+bool _Read(_Reader &in, VtValue &value) {
+    uint16_t typeId = emptyValueId;
+    if (!_Read(in, typeId)) {
+        return false;
+    }
+    if (typeId == emptyValueId) {
+        value = VtValue();
+        return true;
+    }
+    if (typeId == unsupportedValueId) {
+        std::string typeName;
+        if (!_Read(in, typeName)) {
+            return false;
+        }
+        TF_WARN("The journal can't restore values of type %s", typeName.c_str());
+        in.hasUnsupportedValue = true;
+        return true;
+    }
+    const auto &codecs = _GetValueCodecs();
+    if (static_cast<size_t>(typeId - firstCodecId) >= codecs.size()) {
+        return false;
+    }
+    return codecs[typeId - firstCodecId].read(in, value);
+}
+
+// Edits
+void _Write(std::string &out, const EditJournal::Edit &edit) {
+    _Write(out, edit.operation);
+    _Write(out, edit.path);
+    switch (edit.operation) {
+    case SetFieldOperation:
+        _Write(out, edit.fieldName);
+        _Write(out, edit.value);
+        break;
+    case SetFieldDictValueByKeyOperation:
+        _Write(out, edit.fieldName);
+        _Write(out, edit.token);
+        _Write(out, edit.value);
+        break;
+    case SetTimeSampleOperation:
+        _Write(out, edit.timeCode);
+        _Write(out, edit.value);
+        break;
+    case CreateSpecOperation:
+        _Write(out, edit.specType);
+        _Write(out, edit.inert);
+        break;
+    case DeleteSpecOperation:
+        _Write(out, edit.inert);
+        break;
+    case MoveSpecOperation:
+        _Write(out, edit.otherPath);
+        break;
+    case PushChildTokenOperation: // falls through
+    case PopChildTokenOperation:
+        _Write(out, edit.fieldName);
+        _Write(out, edit.token);
+        break;
+    case PushChildPathOperation: // falls through
+    case PopChildPathOperation:
+        _Write(out, edit.fieldName);
+        _Write(out, edit.otherPath);
+        break;
+    }
+}
+
+bool _Read(_Reader &in, EditJournal::Edit &edit) {
+    if (!_Read(in, edit.operation) || !_Read(in, edit.path)) {
+        return false;
+    }
+    switch (edit.operation) {
+    case SetFieldOperation:
+        return _Read(in, edit.fieldName) && _Read(in, edit.value);
+    case SetFieldDictValueByKeyOperation:
+        return _Read(in, edit.fieldName) && _Read(in, edit.token) && _Read(in, edit.value);
+    case SetTimeSampleOperation:
+        return _Read(in, edit.timeCode) && _Read(in, edit.value);
+    case CreateSpecOperation:
+        return _Read(in, edit.specType) && _Read(in, edit.inert);
+    case DeleteSpecOperation:
+        return _Read(in, edit.inert);
+    case MoveSpecOperation:
+        return _Read(in, edit.otherPath);
+    case PushChildTokenOperation: // falls through
+    case PopChildTokenOperation:
+        return _Read(in, edit.fieldName) && _Read(in, edit.token);
+    case PushChildPathOperation: // falls through
+    case PopChildPathOperation:
+        return _Read(in, edit.fieldName) && _Read(in, edit.otherPath);
+    }
+    return false;
+}
+
+// Apply the edit on the layer, returns false if the layer is not in the state expected by the edit
+bool _ReplayEdit(const SdfLayerRefPtr &layer, const EditJournal::Edit &edit) {
+    const SdfLayerStateDelegateBasePtr delegate = layer->GetStateDelegate();
+    if (!delegate) {
+        return false;
+    }
+    switch (edit.operation) {
+    case SetFieldOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->SetField(edit.path, edit.fieldName, edit.value);
+        return true;
+    case SetFieldDictValueByKeyOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->SetFieldDictValueByKey(edit.path, edit.fieldName, edit.token, edit.value);
+        return true;
+    case SetTimeSampleOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->SetTimeSample(edit.path, edit.timeCode, edit.value);
+        return true;
+    case CreateSpecOperation:
+        if (layer->HasSpec(edit.path))
+            return false;
+        delegate->CreateSpec(edit.path, static_cast<SdfSpecType>(edit.specType), edit.inert);
+        return true;
+    case DeleteSpecOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->DeleteSpec(edit.path, edit.inert);
+        return true;
+    case MoveSpecOperation:
+        if (!layer->HasSpec(edit.path) || layer->HasSpec(edit.otherPath))
+            return false;
+        delegate->MoveSpec(edit.path, edit.otherPath);
+        return true;
+    case PushChildTokenOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->PushChild(edit.path, edit.fieldName, edit.token);
+        return true;
+    case PushChildPathOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->PushChild(edit.path, edit.fieldName, edit.otherPath);
+        return true;
+    case PopChildTokenOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->PopChild(edit.path, edit.fieldName, edit.token);
+        return true;
+    case PopChildPathOperation:
+        if (!layer->HasSpec(edit.path))
+            return false;
+        delegate->PopChild(edit.path, edit.fieldName, edit.otherPath);
+        return true;
+    }
+    return false;
+}
+
+bool _ReadHeader(_Reader &in, std::string &layerIdentifier) {
+    char magic[sizeof(journalMagic)];
+    uint32_t version = 0;
+    return in.Read(magic, sizeof(magic)) && memcmp(magic, journalMagic, sizeof(magic)) == 0 && _Read(in, version) &&
+           version == journalVersion && _Read(in, layerIdentifier);
+}
+
+bool _ReadFile(const std::string &filePath, std::string &content) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+// Flush the file to the disk, so the journal survives a system crash
+void _SyncFile(FILE *file) {
+    fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+// Time between two batches of writes
+constexpr std::chrono::milliseconds journalSyncInterval(1000);
+
+} // namespace
+
+EditJournal &EditJournal::GetInstance() {
+    static EditJournal instance;
+    return instance;
+}
+
+EditJournal::~EditJournal() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopWorker = true;
+    }
+    _wakeUp.notify_one();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+    for (auto &journalFile : _journalFiles) {
+        fclose(journalFile.second);
+    }
+}
+
+void EditJournal::SetDirectory(const std::string &directory) { _directory = directory; }
+
+void EditJournal::SetEnabled(bool enabled) {
+    if (enabled == _enabled) {
+        return;
+    }
+    if (enabled) {
+        if (_directory.empty() || !TfMakeDirs(_directory, -1, true)) {
+            TF_WARN("Unable to create the journal directory '%s'", _directory.c_str());
+            return;
+        }
+        // The edits made before are not in the journal, it would be replayed on a file missing them
+        for (const SdfLayerHandle &layer : SdfLayer::GetLoadedLayers()) {
+            if (layer && layer->IsDirty() && !layer->IsAnonymous()) {
+                _unsavedLayers.emplace(layer->GetIdentifier(), layer);
+            }
+        }
+        _stopWorker = false;
+        _worker = std::thread(&EditJournal::_Run, this);
+        _enabled = true;
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopWorker = true;
+        }
+        _wakeUp.notify_one();
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+        _enabled = false;
+        // The journals are incomplete from now on, they are deleted
+        for (auto &journalFile : _journalFiles) {
+            fclose(journalFile.second);
+            TfDeleteFile(_GetJournalPath(journalFile.first));
+        }
+        _journalFiles.clear();
+        _journaledLayers.clear();
+        _unsavedLayers.clear();
+    }
+}
+
+void EditJournal::Shutdown() { SetEnabled(false); }
+
+std::string EditJournal::_GetJournalPath(const std::string &layerIdentifier) const {
+    // FNV-1a, the hash must be the same between two sessions
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : layerIdentifier) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return TfStringCatPaths(_directory, TfStringPrintf("%016llx%s", static_cast<unsigned long long>(hash), journalExtension));
+}
+
+void EditJournal::_Push(const SdfLayerHandle &layer, Edit &&edit) {
+    if (!_enabled || !layer || layer->IsAnonymous()) {
+        return;
+    }
+    const std::string &layerIdentifier = layer->GetIdentifier();
+    if (_unsavedLayers.count(layerIdentifier)) {
+        return;
+    }
+    _journaledLayers.emplace(layerIdentifier, layer);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pendingEdits.emplace_back(layerIdentifier, std::move(edit));
+}
+
+void EditJournal::SetField(const SdfLayerHandle &layer, const SdfPath &path, const TfToken &fieldName, const VtValue &value) {
+    Edit edit;
+    edit.operation = SetFieldOperation;
+    edit.path = path;
+    edit.fieldName = fieldName;
+    edit.value = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::SetFieldDictValueByKey(const SdfLayerHandle &layer, const SdfPath &path, const TfToken &fieldName,
+                                         const TfToken &keyPath, const VtValue &value) {
+    Edit edit;
+    edit.operation = SetFieldDictValueByKeyOperation;
+    edit.path = path;
+    edit.fieldName = fieldName;
+    edit.token = keyPath;
+    edit.value = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::SetTimeSample(const SdfLayerHandle &layer, const SdfPath &path, double timeCode, const VtValue &value) {
+    Edit edit;
+    edit.operation = SetTimeSampleOperation;
+    edit.path = path;
+    edit.timeCode = timeCode;
+    edit.value = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::CreateSpec(const SdfLayerHandle &layer, const SdfPath &path, SdfSpecType specType, bool inert) {
+    Edit edit;
+    edit.operation = CreateSpecOperation;
+    edit.path = path;
+    edit.specType = static_cast<int>(specType);
+    edit.inert = inert;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::DeleteSpec(const SdfLayerHandle &layer, const SdfPath &path, bool inert) {
+    Edit edit;
+    edit.operation = DeleteSpecOperation;
+    edit.path = path;
+    edit.inert = inert;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::MoveSpec(const SdfLayerHandle &layer, const SdfPath &oldPath, const SdfPath &newPath) {
+    Edit edit;
+    edit.operation = MoveSpecOperation;
+    edit.path = oldPath;
+    edit.otherPath = newPath;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::PushChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName,
+                            const TfToken &value) {
+    Edit edit;
+    edit.operation = PushChildTokenOperation;
+    edit.path = parentPath;
+    edit.fieldName = fieldName;
+    edit.token = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::PushChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName,
+                            const SdfPath &value) {
+    Edit edit;
+    edit.operation = PushChildPathOperation;
+    edit.path = parentPath;
+    edit.fieldName = fieldName;
+    edit.otherPath = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::PopChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName,
+                           const TfToken &value) {
+    Edit edit;
+    edit.operation = PopChildTokenOperation;
+    edit.path = parentPath;
+    edit.fieldName = fieldName;
+    edit.token = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::PopChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName,
+                           const SdfPath &value) {
+    Edit edit;
+    edit.operation = PopChildPathOperation;
+    edit.path = parentPath;
+    edit.fieldName = fieldName;
+    edit.otherPath = value;
+    _Push(layer, std::move(edit));
+}
+
+void EditJournal::CopySpecs(const SdfLayerHandle &layer, const SdfAbstractData &data) {
+    if (!_enabled) {
+        return;
+    }
+    // Sorting the paths makes sure the parents are created before their children
+    struct _PathCollector : public SdfAbstractDataSpecVisitor {
+        bool VisitSpec(const SdfAbstractData &, const SdfPath &path) override {
+            paths.push_back(path);
+            return true;
+        }
+        void Done(const SdfAbstractData &) override {}
+        SdfPathVector paths;
+    } collector;
+    data.VisitSpecs(&collector);
+    std::sort(collector.paths.begin(), collector.paths.end());
+    for (const SdfPath &path : collector.paths) {
+        CreateSpec(layer, path, data.GetSpecType(path), false);
+        for (const TfToken &field : data.List(path)) {
+            SetField(layer, path, field, data.Get(path, field));
+        }
+    }
+}
+
+void EditJournal::Update() {
+    if (!_enabled) {
+        return;
+    }
+    for (auto it = _journaledLayers.begin(); it != _journaledLayers.end();) {
+        if (!it->second || !it->second->IsDirty()) {
+            Edit discard;
+            discard.operation = DiscardJournalOperation;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _pendingEdits.emplace_back(it->first, std::move(discard));
+            }
+            it = _journaledLayers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = _unsavedLayers.begin(); it != _unsavedLayers.end();) {
+        it = !it->second || !it->second->IsDirty() ? _unsavedLayers.erase(it) : std::next(it);
+    }
+}
+
+void EditJournal::_Run() {
+    std::vector<std::pair<std::string, Edit>> edits;
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool stopWorker = false;
+    while (!stopWorker) {
+        _wakeUp.wait_for(lock, journalSyncInterval, [this]() { return _stopWorker; });
+        stopWorker = _stopWorker;
+        edits.swap(_pendingEdits);
+        lock.unlock();
+        _WriteEdits(edits);
+        edits.clear();
+        lock.lock();
+    }
+}
+
+void EditJournal::_WriteEdits(std::vector<std::pair<std::string, Edit>> &edits) {
+    // Serialize all the edits of a layer before writing them in one go
+    std::unordered_map<std::string, std::string> buffers;
+    for (const auto &layerEdit : edits) {
+        const std::string &layerIdentifier = layerEdit.first;
+        if (layerEdit.second.operation == DiscardJournalOperation) {
+            buffers.erase(layerIdentifier);
+            _CloseJournalFile(layerIdentifier);
+            const std::string journalPath = _GetJournalPath(layerIdentifier);
+            if (TfIsFile(journalPath)) {
+                TfDeleteFile(journalPath);
+            }
+            continue;
+        }
+        std::string &buffer = buffers[layerIdentifier];
+        const size_t sizePosition = buffer.size();
+        _Write(buffer, uint32_t(0));
+        _Write(buffer, layerEdit.second);
+        const uint32_t recordSize = static_cast<uint32_t>(buffer.size() - sizePosition - sizeof(uint32_t));
+        memcpy(&buffer[sizePosition], &recordSize, sizeof(uint32_t));
+    }
+    for (const auto &buffer : buffers) {
+        if (buffer.second.empty()) {
+            continue;
+        }
+        if (FILE *file = _GetJournalFile(buffer.first)) {
+            fwrite(buffer.second.data(), 1, buffer.second.size(), file);
+            _SyncFile(file);
+        }
+    }
+}
+
+FILE *EditJournal::_GetJournalFile(const std::string &layerIdentifier) {
+    auto found = _journalFiles.find(layerIdentifier);
+    if (found != _journalFiles.end()) {
+        return found->second;
+    }
+    FILE *file = fopen(_GetJournalPath(layerIdentifier).c_str(), "ab");
+    if (!file) {
+        TF_WARN("Unable to open the journal of %s", layerIdentifier.c_str());
+        return nullptr;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        std::string header(journalMagic, sizeof(journalMagic));
+        _Write(header, journalVersion);
+        _Write(header, layerIdentifier);
+        fwrite(header.data(), 1, header.size(), file);
+    }
+    _journalFiles[layerIdentifier] = file;
+    return file;
+}
+
+void EditJournal::_CloseJournalFile(const std::string &layerIdentifier) {
+    auto found = _journalFiles.find(layerIdentifier);
+    if (found != _journalFiles.end()) {
+        fclose(found->second);
+        _journalFiles.erase(found);
+    }
+}
+
+std::vector<std::string> EditJournal::GetRecoverableLayers() const {
+    std::vector<std::string> layerIdentifiers;
+    if (_directory.empty() || !TfIsDir(_directory)) {
+        return layerIdentifiers;
+    }
+    for (const std::string &fileName : TfListDir(_directory)) {
+        if (!TfStringEndsWith(fileName, journalExtension)) {
+            continue;
+        }
+        // Only the header is needed, the identifier is read with the length written before it
+        std::ifstream file(fileName, std::ios::binary);
+        std::string header(sizeof(journalMagic) + sizeof(journalVersion) + sizeof(uint32_t), '\0');
+        file.read(&header[0], header.size());
+        uint32_t identifierSize = 0;
+        if (file.gcount() != static_cast<std::streamsize>(header.size())) {
+            continue;
+        }
+        memcpy(&identifierSize, &header[header.size() - sizeof(uint32_t)], sizeof(uint32_t));
+        if (identifierSize > journalMaxIdentifierSize) {
+            continue;
+        }
+        const size_t identifierBegin = header.size();
+        header.resize(identifierBegin + identifierSize);
+        file.read(&header[identifierBegin], identifierSize);
+        header.resize(identifierBegin + static_cast<size_t>(file.gcount()));
+        _Reader in{header.data(), header.data() + header.size()};
+        std::string layerIdentifier;
+        if (_ReadHeader(in, layerIdentifier) && TfGetBaseName(fileName) == TfGetBaseName(_GetJournalPath(layerIdentifier))) {
+            layerIdentifiers.push_back(layerIdentifier);
+        }
+    }
+    return layerIdentifiers;
+}
+
+SdfLayerRefPtr EditJournal::Recover(const std::string &layerIdentifier) {
+    std::string content;
+    std::string journalIdentifier;
+    if (!_ReadFile(_GetJournalPath(layerIdentifier), content)) {
+        TF_WARN("Unable to read the journal of %s", layerIdentifier.c_str());
+        return {};
+    }
+    _Reader in{content.data(), content.data() + content.size()};
+    if (!_ReadHeader(in, journalIdentifier) || journalIdentifier != layerIdentifier) {
+        TF_WARN("The journal of %s is corrupted", layerIdentifier.c_str());
+        return {};
+    }
+    SdfLayerRefPtr layer = SdfLayer::FindOrOpen(layerIdentifier);
+    if (!layer) {
+        TF_WARN("Unable to open %s, its journal is kept", layerIdentifier.c_str());
+        return {};
+    }
+    size_t skippedEdits = 0;
+    {
+        SdfChangeBlock block;
+        while (in.Remaining()) {
+            uint32_t recordSize = 0;
+            // A record which is not complete is the last one written before the crash
+            if (!_Read(in, recordSize) || in.Remaining() < recordSize) {
+                break;
+            }
+            _Reader record{in.cur, in.cur + recordSize};
+            in.cur += recordSize;
+            Edit edit;
+            if (!_Read(record, edit) || record.hasUnsupportedValue || !_ReplayEdit(layer, edit)) {
+                skippedEdits++;
+            }
+        }
+    }
+    if (skippedEdits) {
+        TF_WARN("%zu edits could not be recovered on %s", skippedEdits, layerIdentifier.c_str());
+    }
+    // The journal stays until the layer is saved, the new edits are appended to it
+    if (_enabled) {
+        _journaledLayers.emplace(layerIdentifier, layer);
+    }
+    return layer;
+}
+
+void EditJournal::Discard(const std::string &layerIdentifier) {
+    if (_enabled) {
+        Edit discard;
+        discard.operation = DiscardJournalOperation;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pendingEdits.emplace_back(layerIdentifier, std::move(discard));
+    } else {
+        const std::string journalPath = _GetJournalPath(layerIdentifier);
+        if (TfIsFile(journalPath)) {
+            TfDeleteFile(journalPath);
+        }
+    }
+}
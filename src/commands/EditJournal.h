@@ -0,0 +1,111 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/usd/sdf/abstractData.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/path.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// EditJournal streams the edits applied by the undo/redo system to an append-only binary file per layer,
+/// so the edits made since the last save can be replayed on the layers after a crash.
+/// The main thread only queues the edits, a worker thread serializes them and syncs the files to disk once per batch.
+///
+class EditJournal {
+public:
+    static EditJournal &GetInstance();
+
+    /// Directory of the journal files, it must be set before enabling the journal
+    void SetDirectory(const std::string &directory);
+    const std::string &GetDirectory() const { return _directory; }
+
+    /// Start or stop the worker thread. Only the edits made while the journal is enabled are recorded, the layers
+    /// already edited when the journal is enabled are journaled after their next save, as a journal must start from
+    /// the content of the file
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const { return _enabled; }
+
+    /// Functions called on the main thread when an edit is applied on a layer, they mirror the state delegate api.
+    /// An empty value erases the field or the time sample
+    void SetField(const SdfLayerHandle &layer, const SdfPath &path, const TfToken &fieldName, const VtValue &value);
+    void SetFieldDictValueByKey(const SdfLayerHandle &layer, const SdfPath &path, const TfToken &fieldName,
+                                const TfToken &keyPath, const VtValue &value);
+    void SetTimeSample(const SdfLayerHandle &layer, const SdfPath &path, double timeCode, const VtValue &value);
+    void CreateSpec(const SdfLayerHandle &layer, const SdfPath &path, SdfSpecType specType, bool inert);
+    void DeleteSpec(const SdfLayerHandle &layer, const SdfPath &path, bool inert);
+    void MoveSpec(const SdfLayerHandle &layer, const SdfPath &oldPath, const SdfPath &newPath);
+    void PushChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName, const TfToken &value);
+    void PushChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName, const SdfPath &value);
+    void PopChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName, const TfToken &value);
+    void PopChild(const SdfLayerHandle &layer, const SdfPath &parentPath, const TfToken &fieldName, const SdfPath &value);
+
+    /// Record the creation of all the specs stored in data, used when a spec deletion is undone
+    void CopySpecs(const SdfLayerHandle &layer, const SdfAbstractData &data);
+
+    /// Called once per frame, drops the journals of the layers that were saved or closed since the last call
+    void Update();
+
+    /// Identifiers of the layers having a journal left by a previous session
+    std::vector<std::string> GetRecoverableLayers() const;
+
+    /// Open the layer and replay its journal. The journal is kept until the layer is saved
+    SdfLayerRefPtr Recover(const std::string &layerIdentifier);
+
+    /// Delete the journal of a layer
+    void Discard(const std::string &layerIdentifier);
+
+    /// Write the pending edits, stop the worker thread and delete all the journals.
+    /// Called when the application closes normally
+    void Shutdown();
+
+    /// A single edit, as stored in the journal
+    struct Edit {
+        uint8_t operation = 0;
+        SdfPath path;
+        SdfPath otherPath;
+        TfToken fieldName;
+        TfToken token;
+        double timeCode = 0.0;
+        int specType = 0;
+        bool inert = false;
+        VtValue value;
+    };
+
+private:
+    EditJournal() = default;
+    ~EditJournal();
+
+    void _Push(const SdfLayerHandle &layer, Edit &&edit);
+    void _Run();
+    void _WriteEdits(std::vector<std::pair<std::string, Edit>> &edits);
+    FILE *_GetJournalFile(const std::string &layerIdentifier);
+    void _CloseJournalFile(const std::string &layerIdentifier);
+    std::string _GetJournalPath(const std::string &layerIdentifier) const;
+
+    std::string _directory;
+    bool _enabled = false;
+
+    /// Layers edited since their last save, only accessed on the main thread
+    std::unordered_map<std::string, SdfLayerHandle> _journaledLayers;
+
+    /// Layers which were dirty when the journal was enabled, not journaled until they are saved
+    std::unordered_map<std::string, SdfLayerHandle> _unsavedLayers;
+
+    /// Edits waiting to be written by the worker thread, protected by _mutex
+    std::vector<std::pair<std::string, Edit>> _pendingEdits;
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    bool _stopWorker = false;
+    std::thread _worker;
+
+    /// Open journals, only accessed by the worker thread
+    std::unordered_map<std::string, FILE *> _journalFiles;
+};
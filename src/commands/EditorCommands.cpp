@@ -11,7 +11,6 @@
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdUtils/dependencies.h>
 #include <string>
-#include "WildcardsCompare.h"
 
 #include "SdfUndoRedoRecorder.h"
 #include "ResourcesLoader.h"
@@ -35,6 +34,10 @@ struct EditorSetDataPointer : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorSetDataPointer>(Editor *editor);
 
+std::unique_lock<std::mutex> LockStagesForEdition() {
+    return EditorCommand::_editor ? EditorCommand::_editor->LockStages() : std::unique_lock<std::mutex>();
+}
+
 struct EditorSetSelection : public EditorCommand {
     EditorSetSelection(UsdStageRefPtr stage, SdfPath path)
     : _stageRefPtr(stage), _path(path) {}
@@ -75,6 +78,73 @@ template void ExecuteAfterDraw<EditorSetSelection>(UsdStageRefPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(SdfLayerRefPtr, SdfPath);
 template void ExecuteAfterDraw<EditorSetSelection>(SdfLayerHandle, SdfPath);
 
+// Select multiple prims of a stage at once, replacing or extending the selection
+struct EditorSelectPaths : public EditorCommand {
+    EditorSelectPaths(UsdStageRefPtr stage, SdfPathVector paths, bool addToSelection = false)
+        : _stage(stage), _paths(std::move(paths)), _addToSelection(addToSelection) {}
+
+    EditorSelectPaths(const UsdStageWeakPtr &stage, SdfPathVector paths, bool addToSelection = false)
+        : _stage(stage), _paths(std::move(paths)), _addToSelection(addToSelection) {}
+
+    ~EditorSelectPaths() override {}
+
+    bool DoIt() override {
+        if (_editor && _stage) {
+            _editor->SetCurrentStage(_stage);
+            if (_addToSelection) {
+                _editor->AddStagePathsSelection(_paths);
+            } else {
+                _editor->SetStagePathsSelection(_paths);
+            }
+        }
+        return false;
+    }
+    UsdStageRefPtr _stage;
+    SdfPathVector _paths;
+    bool _addToSelection;
+};
+template void ExecuteAfterDraw<EditorSelectPaths>(UsdStageRefPtr, SdfPathVector);
+template void ExecuteAfterDraw<EditorSelectPaths>(UsdStageRefPtr, SdfPathVector, bool);
+template void ExecuteAfterDraw<EditorSelectPaths>(UsdStageWeakPtr, SdfPathVector);
+template void ExecuteAfterDraw<EditorSelectPaths>(UsdStageWeakPtr, SdfPathVector, bool);
+
+// Select a prim and all its descendants passing the default predicate, instance proxies included
+struct EditorSelectDescendants : public EditorCommand {
+    EditorSelectDescendants(UsdStageRefPtr stage, SdfPath path, bool addToSelection = false)
+        : _stage(stage), _path(path), _addToSelection(addToSelection) {}
+
+    EditorSelectDescendants(const UsdStageWeakPtr &stage, SdfPath path, bool addToSelection = false)
+        : _stage(stage), _path(path), _addToSelection(addToSelection) {}
+
+    ~EditorSelectDescendants() override {}
+
+    bool DoIt() override {
+        if (_editor && _stage) {
+            const UsdPrim prim = _stage->GetPrimAtPath(_path);
+            if (!prim) {
+                return false;
+            }
+            SdfPathVector paths;
+            for (const UsdPrim &descendant : UsdPrimRange(prim, UsdTraverseInstanceProxies(UsdPrimDefaultPredicate))) {
+                paths.push_back(descendant.GetPath());
+            }
+            _editor->SetCurrentStage(_stage);
+            if (_addToSelection) {
+                _editor->AddStagePathsSelection(paths);
+            } else {
+                _editor->SetStagePathsSelection(paths);
+            }
+        }
+        return false;
+    }
+    UsdStageRefPtr _stage;
+    SdfPath _path;
+    bool _addToSelection;
+};
+template void ExecuteAfterDraw<EditorSelectDescendants>(UsdStageRefPtr, SdfPath);
+template void ExecuteAfterDraw<EditorSelectDescendants>(UsdStageWeakPtr, SdfPath);
+template void ExecuteAfterDraw<EditorSelectDescendants>(UsdStageWeakPtr, SdfPath, bool);
+
 // TODO use setlayerlocation instead ???
 struct EditorSelectAttributePath : public EditorCommand {
 
@@ -111,6 +181,97 @@ struct EditorOpenStage : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorOpenStage>(std::string stagePath);
 
+// Open the layers of the stage again in a new stage composing only the prims under the paths
+struct EditorOpenStageSubset : public EditorCommand {
+
+    EditorOpenStageSubset(UsdStageWeakPtr stage, SdfPathVector paths) : _stage(stage), _paths(std::move(paths)) {}
+    ~EditorOpenStageSubset() override {}
+
+    bool DoIt() override {
+        if (_editor && _stage && !_paths.empty()) {
+            _editor->OpenStageSubset(UsdStageRefPtr(_stage), _paths);
+        }
+        return false; // never store this command
+    }
+
+    UsdStageWeakPtr _stage;
+    SdfPathVector _paths;
+};
+template void ExecuteAfterDraw<EditorOpenStageSubset>(UsdStageWeakPtr stage, SdfPathVector paths);
+
+// The population mask is not stored in the layers, the changes of the mask are not in the undo history
+struct EditorAddToPopulationMask : public EditorCommand {
+
+    EditorAddToPopulationMask(UsdStageWeakPtr stage, SdfPath path) : _stage(stage), _path(std::move(path)) {}
+    ~EditorAddToPopulationMask() override {}
+
+    bool DoIt() override {
+        if (_stage) {
+            UsdStagePopulationMask mask = _stage->GetPopulationMask();
+            _stage->SetPopulationMask(mask.Add(_path));
+        }
+        return false; // never store this command
+    }
+
+    UsdStageWeakPtr _stage;
+    SdfPath _path;
+};
+template void ExecuteAfterDraw<EditorAddToPopulationMask>(UsdStageWeakPtr stage, SdfPath path);
+
+// A mask can only include subtrees: when the path is under a path of the mask, the mask path is replaced by the siblings
+// of the path and the siblings of its ancestors up to the mask path
+struct EditorRemoveFromPopulationMask : public EditorCommand {
+
+    EditorRemoveFromPopulationMask(UsdStageWeakPtr stage, SdfPath path) : _stage(stage), _path(std::move(path)) {}
+    ~EditorRemoveFromPopulationMask() override {}
+
+    bool DoIt() override {
+        if (!_stage || _path.IsAbsoluteRootPath()) {
+            return false;
+        }
+        SdfPathVector paths;
+        for (const SdfPath &maskPath : _stage->GetPopulationMask().GetPaths()) {
+            if (maskPath.HasPrefix(_path)) {
+                continue;
+            }
+            if (!_path.HasPrefix(maskPath)) {
+                paths.push_back(maskPath);
+                continue;
+            }
+            for (SdfPath path = _path; path != maskPath; path = path.GetParentPath()) {
+                for (const UsdPrim &sibling : _stage->GetPrimAtPath(path.GetParentPath()).GetAllChildren()) {
+                    if (sibling.GetPath() != path) {
+                        paths.push_back(sibling.GetPath());
+                    }
+                }
+            }
+        }
+        _stage->SetPopulationMask(UsdStagePopulationMask(paths));
+        return false; // never store this command
+    }
+
+    UsdStageWeakPtr _stage;
+    SdfPath _path;
+};
+template void ExecuteAfterDraw<EditorRemoveFromPopulationMask>(UsdStageWeakPtr stage, SdfPath path);
+
+// Add the targets of the relationships and the connections of the masked prims
+struct EditorExpandPopulationMask : public EditorCommand {
+
+    EditorExpandPopulationMask(UsdStageWeakPtr stage) : _stage(stage) {}
+    ~EditorExpandPopulationMask() override {}
+
+    bool DoIt() override {
+        if (_stage) {
+            _stage->ExpandPopulationMask();
+        }
+        return false; // never store this command
+    }
+
+    UsdStageWeakPtr _stage;
+};
+template void ExecuteAfterDraw<EditorExpandPopulationMask>(UsdStageWeakPtr stage);
+
 struct EditorSetCurrentStage : public EditorCommand {
 
     EditorSetCurrentStage(SdfLayerHandle layer) : _layer(layer) {}
@@ -222,6 +383,24 @@ struct EditorSaveLayerAs : public EditorCommand {
 template void ExecuteAfterDraw<EditorSaveLayerAs>(SdfLayerHandle layer);
 template void ExecuteAfterDraw<EditorSaveLayerAs>(SdfLayerRefPtr layer);
 
+// The layer is written in the background, saving doesn't change the layer content so it is not stored
+struct EditorSaveLayer : public EditorCommand {
+
+    EditorSaveLayer(SdfLayerHandle layer) : _layer(layer) {}
+    EditorSaveLayer(SdfLayerRefPtr layer) : _layer(layer) {}
+    ~EditorSaveLayer() override {}
+
+    bool DoIt() override {
+        if (_editor) {
+            _editor->SaveLayer(_layer);
+        }
+        return false;
+    }
+    SdfLayerRefPtr _layer;
+};
+template void ExecuteAfterDraw<EditorSaveLayer>(SdfLayerHandle layer);
+template void ExecuteAfterDraw<EditorSaveLayer>(SdfLayerRefPtr layer);
+
 struct EditorSetPreviousLayer : public EditorCommand {
 
     EditorSetPreviousLayer() {}
@@ -329,14 +508,11 @@ struct EditorRemoveLauncher : public EditorCommand {
 };
 template void ExecuteAfterDraw<EditorRemoveLauncher>(const std::string);
 
-// This will try to find the next matching prim after the selection
+// This will try to find the next matching prim after the selection, or select all the matching prims
 struct EditorFindPrim : public EditorCommand {
-    EditorFindPrim(const std::string pattern, bool useRegex) : _pattern(pattern) {
-        if (useRegex) {
-            _matches = [&](const std::string &str) { return FastWildComparePortable(_pattern.c_str(), str.c_str()); };
-        } else {
-            _matches = [&](const std::string &str) { return str == _pattern; };
-        }
+    EditorFindPrim(const std::string pattern, PrimNameMatch match, bool selectAll = false)
+        : _pattern(pattern), _selectAll(selectAll) {
+        _matches = MakePrimNameMatcher(_pattern, match);
     }
     ~EditorFindPrim() override{};
 
@@ -345,12 +521,34 @@ struct EditorFindPrim : public EditorCommand {
             const auto &stage = _editor->GetCurrentStage();
             auto &selection = _editor->GetSelection();
             auto anchor = selection.GetAnchorPrimPath(stage);
+            const PrimNameIndex &index = _editor->GetPrimNameIndex();
+            if (index.IsReady()) {
+                if (_selectAll) {
+                    const SdfPathVector found = index.FindAll(_matches);
+                    if (!found.empty()) {
+                        selection.SetSelected(stage, found);
+                    }
+                    return false;
+                }
+                const SdfPath found = index.FindNext(_matches, anchor);
+                if (found != SdfPath()) {
+                    selection.SetSelected(stage, found);
+                }
+                return false;
+            }
+            // The index is not built yet, the stage is traversed
             SdfPath found;
+            SdfPathVector allFound;
             bool selectedFound = false;
             // Traverse the stage and set the new selection
             auto range = UsdPrimRange::Stage(stage, UsdTraverseInstanceProxies(UsdPrimAllPrimsPredicate));
             for (auto iter = range.begin(); iter != range.end(); ++iter) {
-                if (iter->GetPath() == anchor) {
+                // All the matching prims are selected, the anchor included like with the index
+                if (_selectAll) {
+                    if (_matches(iter->GetName())) {
+                        allFound.push_back(iter->GetPath());
+                    }
+                } else if (iter->GetPath() == anchor) {
                     selectedFound = true;
                 } else if (_matches(iter->GetName())) {
                     // Store the first matching path in case we don't find the one
@@ -367,6 +565,9 @@ struct EditorFindPrim : public EditorCommand {
                     }
                 }
             }
+            if (!allFound.empty()) {
+                selection.SetSelected(stage, allFound);
+            }
             if (found != SdfPath()) {
                 selection.SetSelected(stage, found);
             }
@@ -375,8 +576,10 @@ struct EditorFindPrim : public EditorCommand {
     }
     std::function<bool(const std::string &)> _matches;
     std::string _pattern;
+    bool _selectAll;
 };
-template void ExecuteAfterDraw<EditorFindPrim>(const std::string, bool useRegex);
+template void ExecuteAfterDraw<EditorFindPrim>(const std::string, PrimNameMatch match);
+template void ExecuteAfterDraw<EditorFindPrim>(const std::string, PrimNameMatch match, bool selectAll);
 
 struct EditorExportUsdz : public EditorCommand {
     EditorExportUsdz(const std::string destination, bool useArKit) : _destination(destination), _useArKit(useArKit) {}
@@ -462,4 +665,15 @@ struct EditorScaleUI : public EditorCommand {
     }
     float _scaleValue;
 };
-template void ExecuteAfterDraw<EditorScaleUI>(float scaleValue);
\ No newline at end of file
+template void ExecuteAfterDraw<EditorScaleUI>(float scaleValue);
+
+// Lowering the budget drops the oldest commands of the undo history
+struct EditorSetUndoMemoryBudget : public EditorCommand {
+    EditorSetUndoMemoryBudget(int megabytes) : _megabytes(megabytes) {}
+    bool DoIt() override {
+        _editor->SetUndoMemoryBudget(_megabytes);
+        return false;
+    }
+    int _megabytes;
+};
+template void ExecuteAfterDraw<EditorSetUndoMemoryBudget>(int megabytes);
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <pxr/usd/sdf/reference.h>
 #include "CommandsImpl.h"
 #include "SdfUndoRedoRecorder.h"
+#include "LayerTextDiff.h"
 #include <pxr/usd/sdf/variantSpec.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -149,39 +150,51 @@ struct LayerUnmute : public Command {
 template void ExecuteAfterDraw<LayerUnmute>(SdfLayerRefPtr layer);
 template void ExecuteAfterDraw<LayerUnmute>(SdfLayerHandle layer);
 
-/* WARNING: this is a brute force and dumb implementation of storing text modification.
- It basically stores the previous and new layer as text in a string. So .... this will eat up the memory
- quite quickly if used intensively.
- But for now it's a quick way to test if text editing is worth in the application.
- */
+/// Replace the text of a layer. Only the root prims whose text changed are imported, so the undo history
+/// keeps the instructions of the modified prims instead of two copies of the layer text.
 struct LayerTextEdit : public SdfLayerCommand {
 
-    LayerTextEdit(SdfLayerRefPtr layer, std::string newText) : _layer(layer), _newText(newText) {}
+    LayerTextEdit(SdfLayerRefPtr layer, std::string newText) : _layer(layer), _newText(std::move(newText)) {}
+
+    // Edit of the text of a single prim, or of the layer header when primPath is the pseudo root
+    LayerTextEdit(SdfLayerRefPtr layer, SdfPath primPath, std::string newText)
+        : _layer(layer), _primPath(std::move(primPath)), _newText(std::move(newText)) {}
 
     ~LayerTextEdit() override {}
 
     bool DoIt() override {
         if (!_layer)
             return false;
-        SdfCommandGroupRecorder recorder(_undoCommands, _layer);
-        if (_oldText.empty()) {
-            _layer->ExportToString(&_oldText);
+        if (_applied) {
+            // Redo, the recorded instructions are replayed
+            _undoCommands.DoIt();
+            return true;
         }
-        return _layer->ImportFromString(_newText);
-        //_layer->SetDirty();
-    };
-
-    bool UndoIt() override {
-        if (!_layer)
+        if (!_primPath.IsEmpty()) {
+            SdfCommandGroupRecorder recorder(_undoCommands, _layer);
+            _applied = ApplyPrimText(_layer, _primPath, _newText);
+            std::string().swap(_newText);
+            return _applied;
+        }
+        std::string oldText;
+        _layer->ExportToString(&oldText);
+        if (oldText == _newText) {
             return false;
-        return _layer->ImportFromString(_oldText);
-    }
+        }
+        SdfCommandGroupRecorder recorder(_undoCommands, _layer);
+        _applied = ApplyLayerTextDiff(_layer, oldText, _newText);
+        // The text is not needed anymore
+        std::string().swap(_newText);
+        return _applied;
+    };
 
     SdfLayerRefPtr _layer;
-    std::string _oldText;
+    SdfPath _primPath;
     std::string _newText;
+    bool _applied = false;
 };
 template void ExecuteAfterDraw<LayerTextEdit>(SdfLayerRefPtr layer, std::string newText);
+template void ExecuteAfterDraw<LayerTextEdit>(SdfLayerRefPtr layer, SdfPath primPath, std::string newText);
 
 struct LayerCreateOversFromPath : public SdfLayerCommand {
 
@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/copyUtils.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/sdf/schema.h>
+#include "LayerTextDiff.h"
+
+namespace {
+
+// Returns the position following the end of the string starting at pos.
+// The usda strings are delimited by " ' """ ''' and the asset paths by @ or @@@
+size_t _SkipString(const std::string &text, size_t pos) {
+    const char quote = text[pos];
+    const bool isTriple = text.compare(pos, 3, std::string(3, quote)) == 0;
+    if (isTriple) {
+        const size_t end = text.find(std::string(3, quote), pos + 3);
+        return end == std::string::npos ? text.size() : end + 3;
+    }
+    for (size_t i = pos + 1; i < text.size(); ++i) {
+        if (text[i] == '\\' && quote != '@') {
+            ++i;
+        } else if (text[i] == quote || text[i] == '\n') {
+            return i + 1;
+        }
+    }
+    return text.size();
+}
+
+size_t _SkipComment(const std::string &text, size_t pos) {
+    const size_t lineEnd = text.find('\n', pos);
+    return lineEnd == std::string::npos ? text.size() : lineEnd;
+}
+
+// If the line starting at pos is a prim definition, returns true and the name of the prim
+bool _IsPrimDefinition(const std::string &text, size_t pos, TfToken &primName) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) {
+        ++pos;
+    }
+    static const char *specifiers[] = {"def", "over", "class"};
+    for (const char *specifier : specifiers) {
+        const size_t length = strlen(specifier);
+        if (text.compare(pos, length, specifier) == 0 && pos + length < text.size() &&
+            (text[pos + length] == ' ' || text[pos + length] == '\t')) {
+            // The name is the first string of the line: def Type "name"
+            const size_t lineEnd = text.find('\n', pos);
+            const size_t nameBegin = text.find('"', pos);
+            if (nameBegin == std::string::npos || nameBegin > lineEnd) {
+                return false;
+            }
+            const size_t nameEnd = text.find('"', nameBegin + 1);
+            if (nameEnd == std::string::npos || nameEnd > lineEnd) {
+                return false;
+            }
+            primName = TfToken(text.substr(nameBegin + 1, nameEnd - nameBegin - 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool _BlocksAreEqual(const std::string &oldText, const UsdaTextBlock &oldBlock, const std::string &newText,
+                     const UsdaTextBlock &newBlock) {
+    return oldBlock.end - oldBlock.begin == newBlock.end - newBlock.begin &&
+           oldText.compare(oldBlock.begin, oldBlock.end - oldBlock.begin, newText, newBlock.begin,
+                           newBlock.end - newBlock.begin) == 0;
+}
+
+// Index of the root prim blocks by name, returns false if a name is used twice
+bool _IndexPrimBlocks(const std::vector<UsdaTextBlock> &blocks, std::unordered_map<TfToken, size_t, TfToken::HashFunctor> &index) {
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        if (!index.emplace(blocks[i].primName, i).second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the innermost prim of the root prim block whose text contains all the differences between the old and
+// the new block. The text outside of this prim is the same in both blocks
+SdfPath _FindChangedPrim(const std::string &oldText, const UsdaTextBlock &oldBlock, const std::vector<UsdaPrimBlock> &oldPrims,
+                         const std::string &newText, const UsdaTextBlock &newBlock, const std::vector<UsdaPrimBlock> &newPrims) {
+    const SdfPath rootPath = SdfPath::AbsoluteRootPath().AppendChild(newBlock.primName);
+    const size_t oldLength = oldBlock.end - oldBlock.begin;
+    const size_t newLength = newBlock.end - newBlock.begin;
+    size_t prefix = 0;
+    while (prefix < oldLength && prefix < newLength && oldText[oldBlock.begin + prefix] == newText[newBlock.begin + prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < oldLength - prefix && suffix < newLength - prefix &&
+           oldText[oldBlock.end - suffix - 1] == newText[newBlock.end - suffix - 1]) {
+        ++suffix;
+    }
+    // The prims are in the order of the text, the last one containing the changes is the innermost
+    const UsdaPrimBlock *changedPrim = nullptr;
+    for (const UsdaPrimBlock &prim : newPrims) {
+        if (prim.begin <= newBlock.begin + prefix && prim.end >= newBlock.end - suffix && prim.path.HasPrefix(rootPath)) {
+            changedPrim = &prim;
+        }
+    }
+    if (!changedPrim || changedPrim->path == rootPath) {
+        return rootPath;
+    }
+    // The same prim must be found in the old text with the same text around it
+    for (const UsdaPrimBlock &prim : oldPrims) {
+        if (prim.path == changedPrim->path && prim.begin - oldBlock.begin == changedPrim->begin - newBlock.begin &&
+            oldBlock.end - prim.end == newBlock.end - changedPrim->end) {
+            return prim.path;
+        }
+    }
+    return rootPath;
+}
+
+void _CopyLayerMetadata(const SdfLayerRefPtr &source, const SdfLayerRefPtr &destination) {
+    const SdfPath &root = SdfPath::AbsoluteRootPath();
+    for (const TfToken &field : destination->ListFields(root)) {
+        if (field != SdfChildrenKeys->PrimChildren && !source->HasField(root, field)) {
+            destination->EraseField(root, field);
+        }
+    }
+    for (const TfToken &field : source->ListFields(root)) {
+        if (field != SdfChildrenKeys->PrimChildren) {
+            destination->SetField(root, field, source->GetField(root, field));
+        }
+    }
+}
+
+} // namespace
+
+std::vector<UsdaTextBlock> SplitUsdaText(const std::string &text) {
+    std::vector<UsdaTextBlock> blocks;
+    blocks.push_back({TfToken(), 0, text.size()});
+    // Depth of the (), [] and {} scopes, a root prim starts on a line at depth 0
+    int depth = 0;
+    bool lineStart = true;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (lineStart && depth == 0) {
+            TfToken primName;
+            if (_IsPrimDefinition(text, pos, primName)) {
+                blocks.back().end = pos;
+                blocks.push_back({primName, pos, text.size()});
+            }
+        }
+        lineStart = false;
+        const char c = text[pos];
+        switch (c) {
+        case '"':
+        case '\'':
+        case '@':
+            pos = _SkipString(text, pos);
+            continue;
+        case '#':
+            pos = _SkipComment(text, pos);
+            continue;
+        case '(':
+        case '[':
+        case '{':
+            depth++;
+            break;
+        case ')':
+        case ']':
+        case '}':
+            depth = std::max(depth - 1, 0);
+            break;
+        case '\n':
+            lineStart = true;
+            break;
+        }
+        ++pos;
+    }
+    return blocks;
+}
+
+bool ApplyLayerTextDiff(const SdfLayerRefPtr &layer, const std::string &oldText, const std::string &newText) {
+    if (!layer) {
+        return false;
+    }
+    const std::vector<UsdaTextBlock> oldBlocks = SplitUsdaText(oldText);
+    const std::vector<UsdaTextBlock> newBlocks = SplitUsdaText(newText);
+    std::unordered_map<TfToken, size_t, TfToken::HashFunctor> oldIndex;
+    std::unordered_map<TfToken, size_t, TfToken::HashFunctor> newIndex;
+    if (!_IndexPrimBlocks(oldBlocks, oldIndex) || !_IndexPrimBlocks(newBlocks, newIndex)) {
+        // Prims defined twice are merged by the parser, the blocks can't be replaced independently
+        return layer->ImportFromString(newText);
+    }
+
+    // Root prims whose text was added, removed or modified
+    std::unordered_set<TfToken, TfToken::HashFunctor> changedPrims;
+    for (size_t i = 1; i < newBlocks.size(); ++i) {
+        const auto found = oldIndex.find(newBlocks[i].primName);
+        if (found == oldIndex.end() || !_BlocksAreEqual(oldText, oldBlocks[found->second], newText, newBlocks[i])) {
+            changedPrims.insert(newBlocks[i].primName);
+        }
+    }
+    for (size_t i = 1; i < oldBlocks.size(); ++i) {
+        if (newIndex.find(oldBlocks[i].primName) == newIndex.end()) {
+            changedPrims.insert(oldBlocks[i].primName);
+        }
+    }
+    const bool headerChanged = !_BlocksAreEqual(oldText, oldBlocks[0], newText, newBlocks[0]);
+    if (!headerChanged && changedPrims.empty()) {
+        return true;
+    }
+
+    // The prims replaced in the layer, the root prims added or removed and the innermost changed prim of the others
+    SdfPathVector replacedPaths;
+    std::vector<UsdaPrimBlock> oldPrims;
+    std::vector<UsdaPrimBlock> newPrims;
+    for (size_t i = 1; i < newBlocks.size(); ++i) {
+        const auto found = oldIndex.find(newBlocks[i].primName);
+        if (changedPrims.count(newBlocks[i].primName) && found != oldIndex.end()) {
+            if (newPrims.empty()) {
+                oldPrims = FindUsdaPrimBlocks(oldText);
+                newPrims = FindUsdaPrimBlocks(newText);
+            }
+            replacedPaths.push_back(_FindChangedPrim(oldText, oldBlocks[found->second], oldPrims, newText, newBlocks[i], newPrims));
+        }
+    }
+    for (const TfToken &primName : changedPrims) {
+        if (!oldIndex.count(primName) || !newIndex.count(primName)) {
+            replacedPaths.push_back(SdfPath::AbsoluteRootPath().AppendChild(primName));
+        }
+    }
+
+    // Parse only the changed root prim blocks, a nested prim might not be valid without its ancestors.
+    // The header is always needed for the format line
+    std::string changedText;
+    if (headerChanged) {
+        changedText.append(newText, newBlocks[0].begin, newBlocks[0].end - newBlocks[0].begin);
+    } else {
+        const size_t formatLineEnd = std::min(newText.find('\n'), newBlocks[0].end);
+        changedText.append(newText, 0, formatLineEnd);
+        changedText.append("\n");
+    }
+    for (size_t i = 1; i < newBlocks.size(); ++i) {
+        if (changedPrims.count(newBlocks[i].primName)) {
+            changedText.append(newText, newBlocks[i].begin, newBlocks[i].end - newBlocks[i].begin);
+        }
+    }
+    SdfLayerRefPtr changedLayer = SdfLayer::CreateAnonymous(".usda");
+    if (!changedLayer->ImportFromString(changedText)) {
+        // The blocks might not be valid on their own, the whole text is parsed to know if it's correct
+        return layer->ImportFromString(newText);
+    }
+
+    SdfChangeBlock block;
+    if (headerChanged) {
+        _CopyLayerMetadata(changedLayer, layer);
+    }
+    for (const SdfPath &primPath : replacedPaths) {
+        const SdfPath parentPath = primPath.GetParentPath();
+        if (parentPath.IsAbsoluteRootPath()) {
+            if (SdfPrimSpecHandle prim = layer->GetPrimAtPath(primPath)) {
+                layer->RemoveRootPrim(prim);
+            }
+            if (changedLayer->HasSpec(primPath)) {
+                SdfCopySpec(changedLayer, primPath, layer, primPath);
+            }
+            continue;
+        }
+        // The text around the nested prim is unchanged, its parent is in both layers
+        SdfPrimSpecHandle parent = layer->GetPrimAtPath(parentPath);
+        if (!parent || !changedLayer->HasSpec(primPath)) {
+            return layer->ImportFromString(newText);
+        }
+        if (SdfPrimSpecHandle prim = layer->GetPrimAtPath(primPath)) {
+            parent->RemoveNameChild(prim);
+        }
+        SdfCopySpec(changedLayer, primPath, layer, primPath);
+        const VtValue children = changedLayer->GetField(parentPath, SdfChildrenKeys->PrimChildren);
+        if (layer->GetField(parentPath, SdfChildrenKeys->PrimChildren) != children) {
+            layer->SetField(parentPath, SdfChildrenKeys->PrimChildren, children);
+        }
+    }
+
+    // The prims copied are added at the end, restore the order of the text
+    TfTokenVector primOrder;
+    for (size_t i = 1; i < newBlocks.size(); ++i) {
+        primOrder.push_back(newBlocks[i].primName);
+    }
+    const TfTokenVector rootPrims = layer->GetFieldAs<TfTokenVector>(SdfPath::AbsoluteRootPath(), SdfChildrenKeys->PrimChildren);
+    if (rootPrims != primOrder && rootPrims.size() == primOrder.size() &&
+        std::is_permutation(rootPrims.begin(), rootPrims.end(), primOrder.begin())) {
+        layer->SetField(SdfPath::AbsoluteRootPath(), SdfChildrenKeys->PrimChildren, VtValue(primOrder));
+    }
+    return true;
+}
+
+std::vector<UsdaPrimBlock> FindUsdaPrimBlocks(const std::string &text) {
+    std::vector<UsdaPrimBlock> blocks;
+    // Opened (), [] and {} scopes, a scope is the body of a prim when its block index is positive
+    struct Scope {
+        int block;
+    };
+    std::vector<Scope> scopes;
+    // Prim waiting for its body to be opened, and the scope depth of the definition
+    int pendingBlock = -1;
+    size_t pendingDepth = 0;
+    bool lineStart = true;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        // A prim is defined at the top level or directly in the body of another prim
+        if (lineStart && pendingBlock < 0 && (scopes.empty() || scopes.back().block >= 0)) {
+            TfToken primName;
+            if (_IsPrimDefinition(text, pos, primName) && SdfPath::IsValidIdentifier(primName)) {
+                const int parent = scopes.empty() ? -1 : scopes.back().block;
+                const SdfPath &parentPath = parent < 0 ? SdfPath::AbsoluteRootPath() : blocks[parent].path;
+                blocks.push_back({parentPath.AppendChild(primName), pos, text.size(), parent});
+                pendingBlock = static_cast<int>(blocks.size() - 1);
+                pendingDepth = scopes.size();
+            }
+        }
+        lineStart = false;
+        switch (text[pos]) {
+        case '"':
+        case '\'':
+        case '@':
+            pos = _SkipString(text, pos);
+            continue;
+        case '#':
+            pos = _SkipComment(text, pos);
+            continue;
+        case '(':
+        case '[':
+            scopes.push_back({-1});
+            break;
+        case '{':
+            if (pendingBlock >= 0 && scopes.size() == pendingDepth) {
+                scopes.push_back({pendingBlock});
+                pendingBlock = -1;
+            } else {
+                scopes.push_back({-1});
+            }
+            break;
+        case ')':
+        case ']':
+        case '}':
+            if (!scopes.empty()) {
+                if (scopes.back().block >= 0) {
+                    const size_t lineEnd = text.find('\n', pos);
+                    blocks[scopes.back().block].end = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+                }
+                scopes.pop_back();
+            }
+            break;
+        case '\n':
+            lineStart = true;
+            break;
+        }
+        ++pos;
+    }
+    return blocks;
+}
+
+bool ApplyPrimText(const SdfLayerRefPtr &layer, const SdfPath &primPath, const std::string &primText) {
+    if (!layer || !primPath.IsAbsoluteRootOrPrimPath()) {
+        return false;
+    }
+    SdfLayerRefPtr changedLayer = SdfLayer::CreateAnonymous(".usda");
+    if (primPath == SdfPath::AbsoluteRootPath()) {
+        if (!changedLayer->ImportFromString(primText)) {
+            return false;
+        }
+        SdfChangeBlock block;
+        _CopyLayerMetadata(changedLayer, layer);
+        return true;
+    }
+
+    // The prim text is parsed alone with a minimal header
+    if (!changedLayer->ImportFromString("#usda 1.0\n" + primText)) {
+        return false;
+    }
+    const SdfPath parentPath = primPath.GetParentPath();
+    SdfPrimSpecHandle parent = layer->GetPrimAtPath(parentPath);
+    if (!parent) {
+        return false;
+    }
+    TfTokenVector newPrims;
+    for (const SdfPrimSpecHandle &newPrim : changedLayer->GetRootPrims()) {
+        const TfToken &primName = newPrim->GetNameToken();
+        if (primName != primPath.GetNameToken() && layer->HasSpec(parentPath.AppendChild(primName))) {
+            TF_WARN("Unable to apply the text, the prim %s already exists", parentPath.AppendChild(primName).GetText());
+            return false;
+        }
+        newPrims.push_back(primName);
+    }
+
+    // The new prims take the place of the edited one in the children of the parent
+    TfTokenVector primOrder;
+    for (const TfToken &primName : layer->GetFieldAs<TfTokenVector>(parentPath, SdfChildrenKeys->PrimChildren)) {
+        if (primName == primPath.GetNameToken()) {
+            primOrder.insert(primOrder.end(), newPrims.begin(), newPrims.end());
+        } else {
+            primOrder.push_back(primName);
+        }
+    }
+
+    SdfChangeBlock block;
+    if (SdfPrimSpecHandle prim = layer->GetPrimAtPath(primPath)) {
+        parent->RemoveNameChild(prim);
+    }
+    for (const TfToken &primName : newPrims) {
+        SdfCopySpec(changedLayer, SdfPath::AbsoluteRootPath().AppendChild(primName), layer, parentPath.AppendChild(primName));
+    }
+    if (layer->GetFieldAs<TfTokenVector>(parentPath, SdfChildrenKeys->PrimChildren) != primOrder) {
+        layer->SetField(parentPath, SdfChildrenKeys->PrimChildren, VtValue(primOrder));
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <pxr/base/tf/token.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/path.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// Functions to apply a text edit of a layer without reimporting the whole layer.
+/// The usda text is split in line ranges, one for the layer header and one for each root prim,
+/// and only the ranges which differ between the old and the new text are imported. In a changed root prim,
+/// only the innermost prim containing the changed lines is replaced.
+///
+
+/// Lines of a usda text defining the layer header or a root prim
+struct UsdaTextBlock {
+    TfToken primName; // empty for the layer header
+    size_t begin;     // offset of the first character of the block in the text
+    size_t end;       // offset following the last character of the block
+};
+
+/// Split a usda text in blocks. The first block is always the layer header, it is followed by one block
+/// per root prim, in the order of the text. A block ends where the next one starts.
+std::vector<UsdaTextBlock> SplitUsdaText(const std::string &text);
+
+/// Apply the changes between oldText, the current text of the layer, and newText on the layer.
+/// Only the innermost prims whose text differ are replaced, falling back to importing the whole text when the
+/// blocks can't be matched. Returns false if newText can't be parsed.
+bool ApplyLayerTextDiff(const SdfLayerRefPtr &layer, const std::string &oldText, const std::string &newText);
+
+/// Lines of a usda text defining a prim, its children included
+struct UsdaPrimBlock {
+    SdfPath path;
+    size_t begin; // offset of the line of the prim definition
+    size_t end;   // offset following the line closing the prim
+    int parent;   // index of the parent prim block, -1 for the root prims
+};
+
+/// Find the blocks of all the prims defined in a usda text, in the order of the text, so a parent comes before
+/// its children. The prims defined in variants don't have their own blocks, they are part of their prim block.
+std::vector<UsdaPrimBlock> FindUsdaPrimBlocks(const std::string &text);
+
+/// Replace the prim at primPath by the prims defined in primText, which usually contains the definition of the
+/// same prim, edited. When primPath is the pseudo root, primText is a layer header and the layer metadata are replaced.
+/// Returns false if primText can't be parsed or if a prim it defines already exists.
+bool ApplyPrimText(const SdfLayerRefPtr &layer, const SdfPath &primPath, const std::string &primText);
@@ -1,47 +1,221 @@
 #include <memory>
+#include <initializer_list>
 #include <iostream>
+#include <utility>
 #include "SdfCommandGroup.h"
 #include "SdfLayerInstructions.h"
+#include "EditJournal.h"
 
+namespace {
+// Index of the pool of InstructionT in the _InstructionPools tuple
+template <typename InstructionT, typename PoolsT> struct _PoolIndex;
+
+template <typename InstructionT, typename... OtherPoolsT>
+struct _PoolIndex<InstructionT, std::tuple<std::vector<InstructionT>, OtherPoolsT...>>
+    : std::integral_constant<uint8_t, 0> {};
+
+template <typename InstructionT, typename PoolT, typename... OtherPoolsT>
+struct _PoolIndex<InstructionT, std::tuple<PoolT, OtherPoolsT...>>
+    : std::integral_constant<uint8_t, 1 + _PoolIndex<InstructionT, std::tuple<OtherPoolsT...>>::value> {};
+
+// The instructions replayed by undo/redo don't go through the undo delegate, their edits are sent to the journal here
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoSetField &inst, bool undo) {
+    EditJournal::GetInstance().SetField(layer, inst._path, inst._fieldName, undo ? inst._previousValue : inst._newValue);
+}
+
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoSetFieldDictValueByKey &inst, bool undo) {
+    EditJournal::GetInstance().SetFieldDictValueByKey(layer, inst._path, inst._fieldName, inst._keyPath,
+                                                      undo ? inst._previousValue : inst._newValue);
+}
+
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoSetTimeSample &inst, bool undo) {
+    EditJournal &journal = EditJournal::GetInstance();
+    if (!undo) {
+        journal.SetTimeSample(layer, inst._path, inst._timeCode, inst._newValue);
+    } else if (inst._hasTimeSamples && inst._isKeyFrame) {
+        journal.SetTimeSample(layer, inst._path, inst._timeCode, inst._previousValue);
+    } else if (inst._hasTimeSamples) {
+        journal.SetTimeSample(layer, inst._path, inst._timeCode, VtValue()); // erase
+    } else {
+        journal.SetField(layer, inst._path, SdfFieldKeys->TimeSamples, inst._previousValue);
+    }
+}
+
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoCreateSpec &inst, bool undo) {
+    if (undo) {
+        EditJournal::GetInstance().DeleteSpec(layer, inst._path, inst._inert);
+    } else {
+        EditJournal::GetInstance().CreateSpec(layer, inst._path, inst._specType, inst._inert);
+    }
+}
+
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoDeleteSpec &inst, bool undo) {
+    if (undo) {
+        if (inst._deletedData) {
+            EditJournal::GetInstance().CopySpecs(layer, *inst._deletedData);
+        }
+    } else {
+        EditJournal::GetInstance().DeleteSpec(layer, inst._path, inst._inert);
+    }
+}
+
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoMoveSpec &inst, bool undo) {
+    if (undo) {
+        EditJournal::GetInstance().MoveSpec(layer, inst._newPath, inst._oldPath);
+    } else {
+        EditJournal::GetInstance().MoveSpec(layer, inst._oldPath, inst._newPath);
+    }
+}
+
+template <typename ValueT>
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoPushChild<ValueT> &inst, bool undo) {
+    if (undo) {
+        EditJournal::GetInstance().PopChild(layer, inst._parentPath, inst._fieldName, inst._value);
+    } else {
+        EditJournal::GetInstance().PushChild(layer, inst._parentPath, inst._fieldName, inst._value);
+    }
+}
+
+template <typename ValueT>
+void _JournalInstruction(const SdfLayerRefPtr &layer, const UndoRedoPopChild<ValueT> &inst, bool undo) {
+    if (undo) {
+        EditJournal::GetInstance().PushChild(layer, inst._parentPath, inst._fieldName, inst._value);
+    } else {
+        EditJournal::GetInstance().PopChild(layer, inst._parentPath, inst._fieldName, inst._value);
+    }
+}
+} // namespace
 
 
 bool SdfCommandGroup::IsEmpty() const { return _instructions.empty(); }
 
-void SdfCommandGroup::Clear() { _instructions.clear(); }
+void SdfCommandGroup::Clear() {
+    _instructions.clear();
+    _pools = _InstructionPools();
+    _layers.clear();
+    _setFieldIndex.clear();
+    _setTimeSampleIndex.clear();
+}
+
+namespace {
+// Call func with the instruction of the pool whose position in the tuple is type, one comparison per pool
+template <typename PoolsT, typename FuncT, size_t... PoolIndices>
+void _VisitPools(PoolsT &pools, uint8_t type, uint32_t index, FuncT &func, std::index_sequence<PoolIndices...>) {
+    (void)std::initializer_list<int>{(type == PoolIndices ? (func(std::get<PoolIndices>(pools)[index]), 0) : 0)...};
+}
+} // namespace
+
+template <typename PoolsT, typename FuncT>
+void SdfCommandGroup::_Visit(PoolsT &pools, const _InstructionRef &ref, FuncT &&func) {
+    _VisitPools(pools, ref.type, ref.index, func, std::make_index_sequence<std::tuple_size<_InstructionPools>::value>());
+}
+
+size_t SdfCommandGroup::GetMemorySize() const {
+    size_t memorySize = _instructions.capacity() * sizeof(_InstructionRef);
+    for (const auto &ref : _instructions) {
+        _Visit(_pools, ref, [&](const auto &inst) { memorySize += sizeof(inst) + inst.GetMemorySize(); });
+    }
+    return memorySize;
+}
+
+uint32_t SdfCommandGroup::_GetLayerIndex(const SdfLayerHandle &layer) {
+    // There is usually only one layer per group, a linear search is enough
+    for (size_t i = 0; i < _layers.size(); ++i) {
+        if (get_pointer(_layers[i]) == get_pointer(layer)) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    _layers.emplace_back(layer);
+    return static_cast<uint32_t>(_layers.size() - 1);
+}
+
+size_t SdfCommandGroup::_ValueKey::Hash::operator()(const _ValueKey &key) const {
+    size_t hash = std::hash<uint32_t>()(key.layer);
+    hash ^= SdfPath::Hash()(key.path) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= TfToken::HashFunctor()(key.field) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<double>()(key.time) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+// When dragging a manipulator or a slider, the same field is set at every mouse move.
+// We keep the previous value of the first instruction and the new value of the last one
+bool SdfCommandGroup::_CoalesceInstruction(uint32_t layer, UndoRedoSetField &inst) {
+    if (inst._fieldName == SdfFieldKeys->TimeSamples) {
+        // The time samples are replaced as a whole, the previous SetTimeSample can't be merged anymore
+        _setTimeSampleIndex.clear();
+    }
+    auto &pool = std::get<std::vector<UndoRedoSetField>>(_pools);
+    const _ValueKey key{layer, inst._path, inst._fieldName, 0.0};
+    auto found = _setFieldIndex.find(key);
+    if (found != _setFieldIndex.end()) {
+        pool[found->second]._newValue = std::move(inst._newValue);
+        return true;
+    }
+    _setFieldIndex[key] = pool.size();
+    return false;
+}
+
+bool SdfCommandGroup::_CoalesceInstruction(uint32_t layer, UndoRedoSetTimeSample &inst) {
+    // A SetField on the time samples followed by this instruction must be replayed in order
+    _setFieldIndex.erase(_ValueKey{layer, inst._path, SdfFieldKeys->TimeSamples, 0.0});
+    auto &pool = std::get<std::vector<UndoRedoSetTimeSample>>(_pools);
+    const _ValueKey key{layer, inst._path, TfToken(), inst._timeCode};
+    auto found = _setTimeSampleIndex.find(key);
+    if (found != _setTimeSampleIndex.end()) {
+        pool[found->second]._newValue = std::move(inst._newValue);
+        return true;
+    }
+    _setTimeSampleIndex[key] = pool.size();
+    return false;
+}
 
 template <typename InstructionT>
-void SdfCommandGroup::StoreInstruction(InstructionT inst) {
-    // TODO: specialize by InstructionT type to compact the instructions in the command,
-    // typically we don't want to store thousand of setField instruction where only the last one matters
-    // One optim would be to look for the previous instruction, check if it is a setfield on the same path, same layer ?
-    // Update the latest instruction instead of inserting a new instruction
-    // As StoreInstruction is templatized, it is possible to specialize it.
-    _instructions.emplace_back(std::move(inst));
-}
-
-
-template void SdfCommandGroup::StoreInstruction<UndoRedoSetField>(UndoRedoSetField inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoSetFieldDictValueByKey>(UndoRedoSetFieldDictValueByKey inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoSetTimeSample>(UndoRedoSetTimeSample inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoCreateSpec>(UndoRedoCreateSpec inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoDeleteSpec>(UndoRedoDeleteSpec inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoMoveSpec>(UndoRedoMoveSpec inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoPushChild<TfToken>>(UndoRedoPushChild<TfToken> inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoPushChild<SdfPath>>(UndoRedoPushChild<SdfPath> inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoPopChild<TfToken>>(UndoRedoPopChild<TfToken> inst);
-template void SdfCommandGroup::StoreInstruction<UndoRedoPopChild<SdfPath>>(UndoRedoPopChild<SdfPath> inst);
+void SdfCommandGroup::StoreInstruction(const SdfLayerHandle &layer, InstructionT inst) {
+    const uint32_t layerIndex = _GetLayerIndex(layer);
+    if (!_CoalesceInstruction(layerIndex, inst)) {
+        auto &pool = std::get<std::vector<InstructionT>>(_pools);
+        _instructions.push_back({_PoolIndex<InstructionT, _InstructionPools>::value, layerIndex,
+                                 static_cast<uint32_t>(pool.size())});
+        pool.emplace_back(std::move(inst));
+    }
+}
+
+template void SdfCommandGroup::StoreInstruction<UndoRedoSetField>(const SdfLayerHandle &layer, UndoRedoSetField inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoSetFieldDictValueByKey>(const SdfLayerHandle &layer, UndoRedoSetFieldDictValueByKey inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoSetTimeSample>(const SdfLayerHandle &layer, UndoRedoSetTimeSample inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoCreateSpec>(const SdfLayerHandle &layer, UndoRedoCreateSpec inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoDeleteSpec>(const SdfLayerHandle &layer, UndoRedoDeleteSpec inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoMoveSpec>(const SdfLayerHandle &layer, UndoRedoMoveSpec inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoPushChild<TfToken>>(const SdfLayerHandle &layer, UndoRedoPushChild<TfToken> inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoPushChild<SdfPath>>(const SdfLayerHandle &layer, UndoRedoPushChild<SdfPath> inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoPopChild<TfToken>>(const SdfLayerHandle &layer, UndoRedoPopChild<TfToken> inst);
+template void SdfCommandGroup::StoreInstruction<UndoRedoPopChild<SdfPath>>(const SdfLayerHandle &layer, UndoRedoPopChild<SdfPath> inst);
 
 // Call all the functions stored in _commands in reverse order
 void SdfCommandGroup::UndoIt() {
     SdfChangeBlock block;
+    const bool journalEnabled = EditJournal::GetInstance().IsEnabled();
     for (auto cmd = _instructions.rbegin(); cmd != _instructions.rend(); ++cmd) {
-        cmd->UndoIt();
+        const SdfLayerRefPtr &layer = _layers[cmd->layer];
+        _Visit(_pools, *cmd, [&](auto &inst) {
+            inst.UndoIt(layer);
+            if (journalEnabled) {
+                _JournalInstruction(layer, inst, true);
+            }
+        });
     }
 }
 
 void SdfCommandGroup::DoIt() {
     SdfChangeBlock block;
-    for (auto &cmd : _instructions) {
-        cmd.DoIt();
+    const bool journalEnabled = EditJournal::GetInstance().IsEnabled();
+    for (const auto &cmd : _instructions) {
+        const SdfLayerRefPtr &layer = _layers[cmd.layer];
+        _Visit(_pools, cmd, [&](auto &inst) {
+            inst.DoIt(layer);
+            if (journalEnabled) {
+                _JournalInstruction(layer, inst, false);
+            }
+        });
     }
 }
@@ -3,56 +3,20 @@
 #include <functional>
 #include <memory>
 #include <iostream>
-
-
-class InstructionWrapper {
-public:
-
-    template <typename InstructionT>
-    InstructionWrapper(InstructionT &&instruction) :
-        _ref(std::make_unique<Storage<InstructionT>>(std::move(instruction))) {
-        _ref->ShowIt();
-    }
-
-    void DoIt() {
-        _ref->DoIt();
-    }
-
-    void UndoIt() {
-        _ref->UndoIt();
-    }
-
-    void ShowIt() {
-        _ref->ShowIt();
-    }
-
-    struct Interface {
-        virtual ~Interface() = default;
-        virtual void DoIt() = 0;
-        virtual void UndoIt() = 0;
-        virtual void ShowIt() = 0;
-    };
-
-    template <typename InstructionT>
-    struct Storage : Interface {
-        Storage(InstructionT &&inst) : _data(std::move(inst)) {
-        }
-        virtual ~Storage(){}
-        void DoIt () override {
-            _data.DoIt();
-        }
-        void UndoIt () override {
-            _data.UndoIt();
-        }
-
-        void ShowIt() override { }
-
-        InstructionT _data;
-    };
-
-    std::unique_ptr<Interface> _ref;
-};
-
+#include <tuple>
+#include <unordered_map>
+#include <cstdint>
+#include <pxr/base/tf/token.h>
+#include <pxr/usd/sdf/path.h>
+#include "SdfLayerInstructions.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// SdfCommandGroup stores the instructions recorded on one or multiple layers.
+/// The instructions are kept by type in contiguous pools and the layers they apply to are stored once
+/// at the group level, so recording a big edit doesn't allocate or increment a layer refcount per instruction.
+///
 class SdfCommandGroup {
 
 public:
@@ -67,11 +31,65 @@ public:
     void DoIt();
     void UndoIt();
 
+    /// Approximate memory used by the recorded instructions, in bytes
+    size_t GetMemorySize() const;
+
     template <typename InstructionT>
-    void StoreInstruction(InstructionT);
+    void StoreInstruction(const SdfLayerHandle &layer, InstructionT);
 
 private:
-    std::vector<InstructionWrapper> _instructions;
-};
 
+    /// One pool per instruction type, the position of the type in the tuple is used as the type tag
+    using _InstructionPools = std::tuple<std::vector<UndoRedoSetField>, std::vector<UndoRedoSetFieldDictValueByKey>,
+                                         std::vector<UndoRedoSetTimeSample>, std::vector<UndoRedoCreateSpec>,
+                                         std::vector<UndoRedoDeleteSpec>, std::vector<UndoRedoMoveSpec>,
+                                         std::vector<UndoRedoPushChild<TfToken>>, std::vector<UndoRedoPushChild<SdfPath>>,
+                                         std::vector<UndoRedoPopChild<TfToken>>, std::vector<UndoRedoPopChild<SdfPath>>>;
+
+    /// Position of an instruction in its pool, the instructions are replayed in the order of the references
+    struct _InstructionRef {
+        uint8_t type;
+        uint32_t layer;
+        uint32_t index;
+    };
+
+    /// Call func with the instruction referenced by ref
+    template <typename PoolsT, typename FuncT> static void _Visit(PoolsT &pools, const _InstructionRef &ref, FuncT &&func);
+
+    uint32_t _GetLayerIndex(const SdfLayerHandle &layer);
+
+    /// Merge the instruction with a previous one editing the same value, returns true if it was merged.
+    /// Only the SetField and SetTimeSample instructions are merged, any other instruction invalidates the
+    /// previous candidates as the order of the edits matters again.
+    bool _CoalesceInstruction(uint32_t layer, UndoRedoSetField &inst);
+    bool _CoalesceInstruction(uint32_t layer, UndoRedoSetTimeSample &inst);
+    template <typename InstructionT> bool _CoalesceInstruction(uint32_t, InstructionT &) {
+        _setFieldIndex.clear();
+        _setTimeSampleIndex.clear();
+        return false;
+    }
+
+    /// Identifies the value edited by a SetField or a SetTimeSample instruction
+    struct _ValueKey {
+        uint32_t layer;
+        SdfPath path;
+        TfToken field;
+        double time;
+        bool operator==(const _ValueKey &other) const {
+            return layer == other.layer && path == other.path && field == other.field && time == other.time;
+        }
+        struct Hash {
+            size_t operator()(const _ValueKey &key) const;
+        };
+    };
+    using _ValueIndex = std::unordered_map<_ValueKey, size_t, _ValueKey::Hash>;
+
+    std::vector<_InstructionRef> _instructions;
+    _InstructionPools _pools;
+    SdfLayerRefPtrVector _layers;
+
+    // Position in its pool of the last mergeable instruction for a given value
+    _ValueIndex _setFieldIndex;
+    _ValueIndex _setTimeSampleIndex;
+};
 
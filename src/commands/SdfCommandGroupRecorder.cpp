@@ -1,6 +1,7 @@
 #include <iostream>
 #include "SdfCommandGroupRecorder.h"
 #include "UndoLayerStateDelegate.h"
+#include "EditJournal.h"
 
 SdfCommandGroupRecorder::SdfCommandGroupRecorder(SdfCommandGroup &undoCommands, SdfLayerRefPtr layer)
 : _undoCommands(undoCommands), _layers({layer}) {
@@ -18,8 +19,14 @@ SdfCommandGroupRecorder::~SdfCommandGroupRecorder() {
 
 
 void SdfCommandGroupRecorder::SetUndoStateDelegates() {
+    SdfCommandGroup *commands = nullptr;
     if (_undoCommands.IsEmpty()) {
-        auto stateDelegate = UndoRedoLayerStateDelegate::New(_undoCommands);
+        commands = &_undoCommands;
+    } else if (EditJournal::GetInstance().IsEnabled()) {
+        commands = &_redoCommands;
+    }
+    if (commands) {
+        auto stateDelegate = UndoRedoLayerStateDelegate::New(*commands);
         for (const auto &layer : _layers) {
             if (layer) {
                 _previousDelegates.push_back(layer->GetStateDelegate());
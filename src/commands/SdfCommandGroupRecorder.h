@@ -25,6 +25,10 @@ private:
     // The _undoCommands is used to make sure we don't change the dele
     SdfCommandGroup &_undoCommands;
 
+    // When a command is redone its instructions are already recorded, the new ones are only kept
+    // here to send them to the edit journal
+    SdfCommandGroup _redoCommands;
+
     // We keep the _previousDelegates of the _layers to restore them when the object is destroyed
     SdfLayerHandleVector _layers;
     SdfLayerStateDelegateBaseRefPtrVector _previousDelegates;
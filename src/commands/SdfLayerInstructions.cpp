@@ -1,8 +1,34 @@
 #include <iostream>
 #include <pxr/usd/sdf/path.h>
 #include <pxr/usd/sdf/abstractData.h>
+#include <pxr/usd/sdf/schema.h>
+#include <pxr/usd/sdf/types.h>
+#include <pxr/base/vt/dictionary.h>
 #include "SdfLayerInstructions.h"
 
+size_t GetValueMemorySize(const VtValue &value) {
+    if (value.IsArrayValued()) {
+        const SdfValueTypeName typeName = SdfSchema::GetInstance().FindType(value);
+        const size_t elementSize = typeName ? typeName.GetScalarType().GetType().GetSizeof() : sizeof(double);
+        return value.GetArraySize() * elementSize;
+    } else if (value.IsHolding<std::string>()) {
+        return value.UncheckedGet<std::string>().capacity();
+    } else if (value.IsHolding<VtDictionary>()) {
+        size_t memorySize = 0;
+        for (const auto &item : value.UncheckedGet<VtDictionary>()) {
+            memorySize += sizeof(item) + item.first.capacity() + GetValueMemorySize(item.second);
+        }
+        return memorySize;
+    } else if (value.IsHolding<SdfTimeSampleMap>()) {
+        size_t memorySize = 0;
+        for (const auto &sample : value.UncheckedGet<SdfTimeSampleMap>()) {
+            memorySize += sizeof(sample) + GetValueMemorySize(sample.second);
+        }
+        return memorySize;
+    }
+    return 0;
+}
+
 static void _CopySpec(const SdfAbstractData &src, SdfAbstractData *dst, const SdfPath &path) {
     if (!dst) {
         std::cerr << "ERROR: when copying the destination prim is null at path " << path.GetString() << std::endl;
@@ -23,28 +49,48 @@ bool UndoRedoDeleteSpec::_SpecCopier::VisitSpec(const SdfAbstractData &src, cons
 void UndoRedoDeleteSpec::_SpecCopier::Done(const SdfAbstractData &) {}
 
 UndoRedoDeleteSpec::UndoRedoDeleteSpec(SdfLayerHandle layer, const SdfPath &path, bool inert, SdfAbstractDataPtr layerData)
-    : _layer(layer), _path(path), _inert(inert), _deletedSpecType(_layer->GetSpecType(path)), _layerData(layerData) {
+    : _path(path), _inert(inert), _layerData(layerData), _deletedSpecType(layer->GetSpecType(path)) {
     // TODO: is there a faster way of copying and restoring the data ?
     // This can be really slow on big scenes
     SdfChangeBlock changeBlock;
     _deletedData = TfCreateRefPtr(new SdfData());
     SdfLayer::TraversalFunction copyFunc = std::bind(&_CopySpec, std::cref(*get_pointer(_layerData)),
                                                      get_pointer(_deletedData), std::placeholders::_1);
-    _layer->Traverse(path, copyFunc);
+    layer->Traverse(path, copyFunc);
 }
 
 
-void UndoRedoDeleteSpec::DoIt() {
-    if (_layer && _layer->GetStateDelegate()) {
-        _layer->GetStateDelegate()->DeleteSpec(_path, _inert);
+// Sums the size of all the fields of the visited specs
+struct _SpecMemorySizeVisitor : public SdfAbstractDataSpecVisitor {
+    bool VisitSpec(const SdfAbstractData &data, const SdfPath &path) override {
+        for (const TfToken &field : data.List(path)) {
+            memorySize += sizeof(VtValue) + GetValueMemorySize(data.Get(path, field));
+        }
+        return true;
+    }
+    void Done(const SdfAbstractData &) override {}
+    size_t memorySize = 0;
+};
+
+size_t UndoRedoDeleteSpec::GetMemorySize() const {
+    _SpecMemorySizeVisitor visitor;
+    if (_deletedData) {
+        _deletedData->VisitSpecs(&visitor);
+    }
+    return visitor.memorySize;
+}
+
+void UndoRedoDeleteSpec::DoIt(const SdfLayerRefPtr &layer) {
+    if (layer && layer->GetStateDelegate()) {
+        layer->GetStateDelegate()->DeleteSpec(_path, _inert);
     }
 }
 
-void UndoRedoDeleteSpec::UndoIt() {
-    if (_layer && _layer->GetStateDelegate()) {
+void UndoRedoDeleteSpec::UndoIt(const SdfLayerRefPtr &layer) {
+    if (layer && layer->GetStateDelegate()) {
         SdfChangeBlock changeBlock;
         _SpecCopier copier(get_pointer(_layerData));
-        _layer->GetStateDelegate()->CreateSpec(_path, _deletedSpecType, _inert);
+        layer->GetStateDelegate()->CreateSpec(_path, _deletedSpecType, _inert);
         _deletedData->VisitSpecs(&copier);
     }
 }
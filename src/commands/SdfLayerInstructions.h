@@ -7,26 +7,31 @@
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
+/// Approximate memory allocated by a value outside of the VtValue itself, in bytes.
+/// Only the arrays, strings, dictionaries and time samples are considered as they are the ones growing big.
+size_t GetValueMemorySize(const VtValue &value);
+
 struct UndoRedoSetField {
-    UndoRedoSetField(SdfLayerHandle layer, const SdfPath& path, const TfToken& fieldName, VtValue newValue, VtValue previousValue )
-        : _layer(layer), _path(path), _fieldName(fieldName), _newValue(std::move(newValue)), _previousValue(std::move(previousValue)) {}
+    UndoRedoSetField(const SdfPath& path, const TfToken& fieldName, VtValue newValue, VtValue previousValue )
+        : _path(path), _fieldName(fieldName), _newValue(std::move(newValue)), _previousValue(std::move(previousValue)) {}
 
     UndoRedoSetField(UndoRedoSetField &&) = default;
     ~UndoRedoSetField() = default;
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->SetField(_path, _fieldName, _newValue);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->SetField(_path, _fieldName, _newValue);
         }
     }
 
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()){
-            _layer->GetStateDelegate()->SetField(_path, _fieldName, _previousValue);
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()){
+            layer->GetStateDelegate()->SetField(_path, _fieldName, _previousValue);
         }
     }
 
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return GetValueMemorySize(_newValue) + GetValueMemorySize(_previousValue); }
+
     const SdfPath _path;
     const TfToken _fieldName;
     VtValue _newValue;
@@ -35,25 +40,26 @@ struct UndoRedoSetField {
 
 
 struct UndoRedoSetFieldDictValueByKey {
-    UndoRedoSetFieldDictValueByKey(SdfLayerHandle layer, const SdfPath &path, const TfToken& fieldName, const TfToken& keyPath, VtValue value, VtValue previousValue)
-        :_layer(layer), _path(path), _fieldName(fieldName), _keyPath(keyPath), _newValue(std::move(value)), _previousValue(previousValue) {}
+    UndoRedoSetFieldDictValueByKey(const SdfPath &path, const TfToken& fieldName, const TfToken& keyPath, VtValue value, VtValue previousValue)
+        :_path(path), _fieldName(fieldName), _keyPath(keyPath), _newValue(std::move(value)), _previousValue(previousValue) {}
 
     UndoRedoSetFieldDictValueByKey(UndoRedoSetFieldDictValueByKey &&) = default;
     ~UndoRedoSetFieldDictValueByKey() = default;
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->SetFieldDictValueByKey(_path, _fieldName, _keyPath, _newValue);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->SetFieldDictValueByKey(_path, _fieldName, _keyPath, _newValue);
         }
     }
 
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()){
-            _layer->GetStateDelegate()->SetFieldDictValueByKey(_path, _fieldName, _keyPath, _previousValue);
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()){
+            layer->GetStateDelegate()->SetFieldDictValueByKey(_path, _fieldName, _keyPath, _previousValue);
         }
     }
 
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return GetValueMemorySize(_newValue) + GetValueMemorySize(_previousValue); }
+
     const SdfPath _path;
     const TfToken _fieldName;
     const TfToken _keyPath;
@@ -64,39 +70,39 @@ struct UndoRedoSetFieldDictValueByKey {
 
 struct UndoRedoSetTimeSample {
     UndoRedoSetTimeSample(SdfLayerHandle layer, const SdfPath &path, double timeCode, VtValue newValue)
-        : _layer(layer), _path(path), _timeCode(timeCode), _newValue(std::move(newValue)), _isKeyFrame(false),
+        : _path(path), _timeCode(timeCode), _newValue(std::move(newValue)), _isKeyFrame(false),
           _hasTimeSamples(false) {
 
-        if (_layer && _layer->HasField(path, SdfFieldKeys->TimeSamples)) {
+        if (layer && layer->HasField(path, SdfFieldKeys->TimeSamples)) {
             _hasTimeSamples = true;
-            _isKeyFrame = _layer->QueryTimeSample(_path, _timeCode, &_previousValue);
+            _isKeyFrame = layer->QueryTimeSample(_path, _timeCode, &_previousValue);
         }
     }
     ~UndoRedoSetTimeSample() = default;
     UndoRedoSetTimeSample(UndoRedoSetTimeSample &&) = default;
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _newValue);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _newValue);
         }
     }
 
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
             if (_hasTimeSamples && _isKeyFrame) {
-                _layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _previousValue);
+                layer->GetStateDelegate()->SetTimeSample(_path, _timeCode, _previousValue);
             } else if (_hasTimeSamples && !_isKeyFrame) {
-                _layer->EraseTimeSample(_path, _timeCode);
+                layer->EraseTimeSample(_path, _timeCode);
             } else if (!_hasTimeSamples) {
-                _layer->GetStateDelegate()->SetField(_path, SdfFieldKeys->TimeSamples, _previousValue);
+                layer->GetStateDelegate()->SetField(_path, SdfFieldKeys->TimeSamples, _previousValue);
             } else {
                 // This shouldn't happen
             }
         }
     }
 
-    // TODO: look for reducing the size of this struct
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return GetValueMemorySize(_newValue) + GetValueMemorySize(_previousValue); }
+
     const SdfPath _path;
     double _timeCode;
     VtValue _newValue;
@@ -107,22 +113,23 @@ struct UndoRedoSetTimeSample {
 
 
 struct UndoRedoCreateSpec {
-    UndoRedoCreateSpec(SdfLayerHandle layer, const SdfPath& path, SdfSpecType specType, bool inert)
-        : _layer(layer), _path(path), _specType(specType), _inert(inert) {}
+    UndoRedoCreateSpec(const SdfPath& path, SdfSpecType specType, bool inert)
+        : _path(path), _specType(specType), _inert(inert) {}
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->CreateSpec(_path, _specType, _inert);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->CreateSpec(_path, _specType, _inert);
         }
     }
 
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->DeleteSpec(_path, _inert);
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->DeleteSpec(_path, _inert);
         }
     }
 
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return 0; }
+
     const SdfPath _path;
     const SdfSpecType _specType;
     const bool _inert;
@@ -143,10 +150,12 @@ struct UndoRedoDeleteSpec {
 
     UndoRedoDeleteSpec(SdfLayerHandle layer, const SdfPath &path, bool inert, SdfAbstractDataPtr layerData);
 
-    void DoIt();
-    void UndoIt();
+    void DoIt(const SdfLayerRefPtr &layer);
+    void UndoIt(const SdfLayerRefPtr &layer);
+
+    /// Size of the copied subtree
+    size_t GetMemorySize() const;
 
-    SdfLayerRefPtr _layer;
     const SdfPath _path;
     const bool _inert;
 
@@ -158,46 +167,48 @@ struct UndoRedoDeleteSpec {
 
 struct UndoRedoMoveSpec {
 
-    UndoRedoMoveSpec(SdfLayerHandle layer, const SdfPath &oldPath, const SdfPath &newPath)
-    : _layer(layer), _oldPath(oldPath), _newPath(newPath) {}
+    UndoRedoMoveSpec(const SdfPath &oldPath, const SdfPath &newPath)
+    : _oldPath(oldPath), _newPath(newPath) {}
 
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()){
-            _layer->GetStateDelegate()->MoveSpec(_oldPath, _newPath);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()){
+            layer->GetStateDelegate()->MoveSpec(_oldPath, _newPath);
         }
 
     };
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()){
-            _layer->GetStateDelegate()->MoveSpec(_newPath, _oldPath);
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()){
+            layer->GetStateDelegate()->MoveSpec(_newPath, _oldPath);
         }
     };
 
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return 0; }
+
     const SdfPath _oldPath;
     const SdfPath _newPath;
 };
 
 template <typename ValueT>
 struct UndoRedoPushChild {
-    UndoRedoPushChild(SdfLayerHandle layer, const SdfPath& parentPath, const TfToken& fieldName, const ValueT& value)
-        : _layer(layer), _parentPath(parentPath), _fieldName(fieldName), _value(value) {}
+    UndoRedoPushChild(const SdfPath& parentPath, const TfToken& fieldName, const ValueT& value)
+        : _parentPath(parentPath), _fieldName(fieldName), _value(value) {}
 
 
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->PopChild(_parentPath, _fieldName, _value);
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->PopChild(_parentPath, _fieldName, _value);
         }
     }
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->PushChild(_parentPath, _fieldName, _value);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->PushChild(_parentPath, _fieldName, _value);
         }
     }
 
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return 0; }
+
     const SdfPath _parentPath;
     const TfToken _fieldName;
     const ValueT _value;
@@ -205,23 +216,24 @@ struct UndoRedoPushChild {
 
 template <typename ValueT>
 struct UndoRedoPopChild {
-    UndoRedoPopChild(SdfLayerHandle layer, const SdfPath& parentPath, const TfToken& fieldName, const ValueT& value)
-        : _layer(layer), _parentPath(parentPath), _fieldName(fieldName), _value(value) {}
+    UndoRedoPopChild(const SdfPath& parentPath, const TfToken& fieldName, const ValueT& value)
+        : _parentPath(parentPath), _fieldName(fieldName), _value(value) {}
 
 
-    void UndoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->PushChild(_parentPath, _fieldName, _value);
+    void UndoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->PushChild(_parentPath, _fieldName, _value);
         }
     }
 
-    void DoIt() {
-        if (_layer && _layer->GetStateDelegate()) {
-            _layer->GetStateDelegate()->PopChild(_parentPath, _fieldName, _value);
+    void DoIt(const SdfLayerRefPtr &layer) {
+        if (layer && layer->GetStateDelegate()) {
+            layer->GetStateDelegate()->PopChild(_parentPath, _fieldName, _value);
         }
     }
 
-    SdfLayerRefPtr _layer;
+    size_t GetMemorySize() const { return 0; }
+
     const SdfPath _parentPath;
     const TfToken _fieldName;
     const ValueT _value;
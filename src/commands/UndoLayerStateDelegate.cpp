@@ -4,6 +4,7 @@
 #include "UndoLayerStateDelegate.h"
 #include "SdfCommandGroupRecorder.h"
 #include "SdfLayerInstructions.h"
+#include "EditJournal.h"
 
 ///
 /// UndoRedoLayerStateDelegate is a delegate used to record Undo functions.
@@ -91,7 +92,8 @@ UndoRedoLayerStateDelegate::_OnSetField(
     SetDirty();
     const VtValue previousValue = _layer->GetField(path, fieldName);
     const VtValue newValue = value;
-    _undoCommands.StoreInstruction<UndoRedoSetField>({_layer, path, fieldName, newValue, previousValue});
+    EditJournal::GetInstance().SetField(_layer, path, fieldName, newValue);
+    _undoCommands.StoreInstruction<UndoRedoSetField>(_layer, {path, fieldName, newValue, previousValue});
 }
 
 void
@@ -104,7 +106,8 @@ UndoRedoLayerStateDelegate::_OnSetField(
     const VtValue previousValue = _layer->GetField(path, fieldName);
     VtValue newValue;
     value.GetValue(&newValue);
-    _undoCommands.StoreInstruction<UndoRedoSetField>({_layer, path, fieldName, newValue, previousValue});
+    EditJournal::GetInstance().SetField(_layer, path, fieldName, newValue);
+    _undoCommands.StoreInstruction<UndoRedoSetField>(_layer, {path, fieldName, newValue, previousValue});
 }
 
 void
@@ -117,7 +120,8 @@ UndoRedoLayerStateDelegate::_OnSetFieldDictValueByKey(
     SetDirty();
     const VtValue previousValue = _layer->GetFieldDictValueByKey(path, fieldName, keyPath); // TODO should the instruction retrieve the value instead ?
     const VtValue newValue = value;
-    _undoCommands.StoreInstruction<UndoRedoSetFieldDictValueByKey>({_layer, path, fieldName, keyPath, newValue, previousValue});
+    EditJournal::GetInstance().SetFieldDictValueByKey(_layer, path, fieldName, keyPath, newValue);
+    _undoCommands.StoreInstruction<UndoRedoSetFieldDictValueByKey>(_layer, {path, fieldName, keyPath, newValue, previousValue});
 }
 
 void
@@ -132,7 +136,8 @@ UndoRedoLayerStateDelegate::_OnSetFieldDictValueByKey(
 
     VtValue newValue;
     value.GetValue(&newValue);
-    _undoCommands.StoreInstruction<UndoRedoSetFieldDictValueByKey>({_layer, path, fieldName, keyPath, newValue, previousValue});
+    EditJournal::GetInstance().SetFieldDictValueByKey(_layer, path, fieldName, keyPath, newValue);
+    _undoCommands.StoreInstruction<UndoRedoSetFieldDictValueByKey>(_layer, {path, fieldName, keyPath, newValue, previousValue});
 }
 
 void
@@ -142,7 +147,8 @@ UndoRedoLayerStateDelegate::_OnSetTimeSample(
     const VtValue& value)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoSetTimeSample>({_layer, path, timeCode, value});
+    EditJournal::GetInstance().SetTimeSample(_layer, path, timeCode, value);
+    _undoCommands.StoreInstruction<UndoRedoSetTimeSample>(_layer, {_layer, path, timeCode, value});
 }
 
 void
@@ -155,7 +161,8 @@ UndoRedoLayerStateDelegate::_OnSetTimeSample(
     VtValue newValue;
     value.GetValue(&newValue);
 
-    _undoCommands.StoreInstruction<UndoRedoSetTimeSample>({_layer, path, timeCode, newValue});
+    EditJournal::GetInstance().SetTimeSample(_layer, path, timeCode, newValue);
+    _undoCommands.StoreInstruction<UndoRedoSetTimeSample>(_layer, {_layer, path, timeCode, newValue});
 }
 
 void
@@ -165,7 +172,8 @@ UndoRedoLayerStateDelegate::_OnCreateSpec(
     bool inert)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoCreateSpec>({_layer, path, specType, inert});
+    EditJournal::GetInstance().CreateSpec(_layer, path, specType, inert);
+    _undoCommands.StoreInstruction<UndoRedoCreateSpec>(_layer, {path, specType, inert});
 }
 
 void
@@ -175,7 +183,8 @@ UndoRedoLayerStateDelegate::_OnDeleteSpec(
 {
     SetDirty();
 
-    _undoCommands.StoreInstruction<UndoRedoDeleteSpec>({_layer, path,  inert, _GetLayerData()});
+    EditJournal::GetInstance().DeleteSpec(_layer, path, inert);
+    _undoCommands.StoreInstruction<UndoRedoDeleteSpec>(_layer, {_layer, path,  inert, _GetLayerData()});
 
 }
 
@@ -185,7 +194,8 @@ UndoRedoLayerStateDelegate::_OnMoveSpec(
     const SdfPath& newPath)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoMoveSpec>({_layer, oldPath, newPath});
+    EditJournal::GetInstance().MoveSpec(_layer, oldPath, newPath);
+    _undoCommands.StoreInstruction<UndoRedoMoveSpec>(_layer, {oldPath, newPath});
 }
 
 void
@@ -195,7 +205,8 @@ UndoRedoLayerStateDelegate::_OnPushChild(
     const TfToken& value)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoPushChild<TfToken>>({_layer, parentPath, fieldName, value});
+    EditJournal::GetInstance().PushChild(_layer, parentPath, fieldName, value);
+    _undoCommands.StoreInstruction<UndoRedoPushChild<TfToken>>(_layer, {parentPath, fieldName, value});
 }
 
 void
@@ -205,7 +216,8 @@ UndoRedoLayerStateDelegate::_OnPushChild(
     const SdfPath& value)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoPushChild<SdfPath>>({_layer, parentPath, fieldName, value});
+    EditJournal::GetInstance().PushChild(_layer, parentPath, fieldName, value);
+    _undoCommands.StoreInstruction<UndoRedoPushChild<SdfPath>>(_layer, {parentPath, fieldName, value});
 }
 
 void
@@ -215,7 +227,8 @@ UndoRedoLayerStateDelegate::_OnPopChild(
     const TfToken& oldValue)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoPopChild<TfToken>>({_layer, parentPath, fieldName, oldValue});
+    EditJournal::GetInstance().PopChild(_layer, parentPath, fieldName, oldValue);
+    _undoCommands.StoreInstruction<UndoRedoPopChild<TfToken>>(_layer, {parentPath, fieldName, oldValue});
 }
 
 void
@@ -225,7 +238,8 @@ UndoRedoLayerStateDelegate::_OnPopChild(
     const SdfPath& oldValue)
 {
     SetDirty();
-    _undoCommands.StoreInstruction<UndoRedoPopChild<SdfPath>>({_layer, parentPath, fieldName, oldValue});
+    EditJournal::GetInstance().PopChild(_layer, parentPath, fieldName, oldValue);
+    _undoCommands.StoreInstruction<UndoRedoPopChild<SdfPath>>(_layer, {parentPath, fieldName, oldValue});
 }
 
 
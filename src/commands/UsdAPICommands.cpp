@@ -22,6 +22,9 @@ struct UsdAPIMaterialBind : public SdfLayerCommand {
 
     ~UsdAPIMaterialBind () override {}
 
+    // Uses the Usd api which needs an up to date stage
+    bool EditsSdfOnly() const override { return false; }
+
     bool DoIt() override {
         if (!_layer)
             return false;
@@ -212,8 +212,11 @@ int main(int argc, char *const *argv) {
             // Normally not required but it fixes a pcoip driver issue
             glFinish();
 
-            // Process edition commands
-            ExecuteCommands();
+            // Process edition commands, the stages are locked as the background tasks might be reading them
+            {
+                auto stageLock = editor.LockStages();
+                ExecuteCommands();
+            }
         }
         editor.RemoveCallbacks(window);
     }
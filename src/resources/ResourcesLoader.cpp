@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iostream>
 
 #include "Constants.h"
@@ -247,3 +248,10 @@ const std::vector<std::string> &ResourcesLoader::GetGlyphRangeNames() {
                                               "Japanese", "Cyrillic", "Thai",   "Vietnamese"};
     return ranges;
 }
+
+std::string ResourcesLoader::GetJournalDirectory() {
+    // The journals are stored next to the config file, replacing the file name
+    std::string journalDirectory = GetConfigFilePath();
+    journalDirectory.resize(journalDirectory.size() - strlen(GUI_CONFIG_FILE));
+    return journalDirectory + "usdtweak_journal";
+}
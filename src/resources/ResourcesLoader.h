@@ -24,6 +24,9 @@ class ResourcesLoader {
     static std::string &GetGlyphRangeName() { return _glyphRange; };
     static const std::vector<std::string> &GetGlyphRangeNames();
 
+    // Directory of the crash recovery journals, next to the settings file
+    static std::string GetJournalDirectory();
+
     // This should not be called during a frame render.
     static void ScaleUI(float scaleValue);
 
@@ -196,6 +196,7 @@ Manipulator *PositionManipulator::OnUpdate(Viewport &viewport) {
 
         GfVec3d translation = _translationOnBegin;
         translation[_selectedAxis] += sign * (_originMouseOnAxis - mouseOnAxis).GetLength();
+        auto stageLock = LockStagesForEdition();
         if (_xformAPI) {
             _xformAPI.SetTranslate(translation, GetEditionTimeCode(viewport));
         } else {
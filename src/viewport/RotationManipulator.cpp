@@ -280,6 +280,7 @@ Manipulator *RotationManipulator::OnUpdate(Viewport &viewport) {
         GfRotation::DecomposeRotation(resultingRotation, xAxis, yAxis, zAxis, 1.0, &thetaTw, &thetaFB, &thetaLR, &thetaSw, true);
         const GfVec3f newRotationValues =
             GfVec3f(GfRadiansToDegrees(thetaTw), GfRadiansToDegrees(thetaFB), GfRadiansToDegrees(thetaLR));
+        auto stageLock = LockStagesForEdition();
         if (_xformAPI) {
             _xformAPI.SetRotate(newRotationValues, rotOrder, GetEditionTimeCode(viewport));
         } else { // Modify only if we have a single matrix
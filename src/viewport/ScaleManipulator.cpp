@@ -184,6 +184,7 @@ Manipulator *ScaleManipulator::OnUpdate(Viewport &viewport) {
             scale[_selectedAxis] = _scaleOnBegin[_selectedAxis] * mouseOnAxis.GetLength() / _originMouseOnAxis.GetLength();
         }
 
+        auto stageLock = LockStagesForEdition();
         if (_xformAPI) {
             _xformAPI.SetScale(scale, GetEditionTimeCode(viewport));
         } else {
@@ -138,7 +138,7 @@ static inline void DrawSaveButton(SdfLayerHandle layer) {
                            layer->IsAnonymous() ? ImVec4(ColorTransparent)
                                                 : (layer->IsDirty() ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorTransparent)));
     if (ImGui::Button(ICON_FA_SAVE "###Save")) {
-        ExecuteAfterDraw(&SdfLayer::Save, layer, true);
+        ExecuteAfterDraw<EditorSaveLayer>(layer);
     }
 }
 
@@ -308,9 +308,18 @@ void DrawContentBrowser(Editor &editor) {
     // TODO: we might want to remove completely the editor here, just pass as selected layer and a selected stage
     SdfLayerHandle selectedLayer(editor.GetCurrentLayer());
     SdfLayerHandle selectedStage(editor.GetCurrentStage() ? editor.GetCurrentStage()->GetRootLayer() : SdfLayerHandle());
-    auto layers = SdfLayer::GetLoadedLayers();
+    // The layers opening in the background are shown once they are all opened
+    static SdfLayerHandleSet layers;
+    if (!editor.IsOpeningLayers()) {
+        layers = SdfLayer::GetLoadedLayers();
+    } else {
+        for (auto it = layers.begin(); it != layers.end();) {
+            it = *it ? std::next(it) : layers.erase(it);
+        }
+    }
     DrawLayerSet(editor.GetStageCache(), layers, &selectedLayer, &selectedStage, options);
+    // The layer keeps its selection
     if (selectedLayer != editor.GetCurrentLayer()) {
-        ExecuteAfterDraw<EditorSetSelection>(selectedLayer, SdfPath::AbsoluteRootPath());
+        ExecuteAfterDraw<EditorSetCurrentLayer>(selectedLayer);
     }
 }
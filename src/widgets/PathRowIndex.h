@@ -0,0 +1,33 @@
+#pragma once
+#include <unordered_map>
+#include <pxr/usd/sdf/path.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+///
+/// PathRowIndex finds the row of a path in the flattened rows of a tree view. It is used by the stage outliner and
+/// the layer hierarchy, the index is rebuilt lazily at the first search after the rows have changed.
+///
+class PathRowIndex {
+  public:
+    /// The rows were modified, the index will be rebuilt by the next Find
+    void Invalidate() { _isValid = false; }
+
+    /// Returns the row of path, or -1 if it is not in the rows. getPath returns the path of a row
+    template <typename RowsT, typename GetPathT> int Find(const SdfPath &path, const RowsT &rows, const GetPathT &getPath) {
+        if (!_isValid) {
+            _rowIndices.clear();
+            _rowIndices.reserve(rows.size());
+            for (int i = 0; i < static_cast<int>(rows.size()); ++i) {
+                _rowIndices.emplace(getPath(rows[i]), i);
+            }
+            _isValid = true;
+        }
+        const auto found = _rowIndices.find(path);
+        return found == _rowIndices.end() ? -1 : found->second;
+    }
+
+  private:
+    std::unordered_map<SdfPath, int, SdfPath::Hash> _rowIndices;
+    bool _isValid = false;
+};
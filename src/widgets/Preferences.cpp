@@ -38,6 +38,28 @@ void PreferencesModalDialog::Draw() {
                 ExecuteAfterDraw<EditorScaleUI>(uiScale);
                 needRestart = true;
             }
+            // The budget is applied when the input is left, the intermediate values typed would drop the undo history
+            static int undoMemoryBudget = 0;
+            static bool isEditingUndoMemoryBudget = false;
+            if (!isEditingUndoMemoryBudget) {
+                undoMemoryBudget = editor.GetUndoMemoryBudget();
+            }
+            ImGui::InputInt("Undo memory budget (MB)", &undoMemoryBudget, 0, 0);
+            isEditingUndoMemoryBudget = ImGui::IsItemActive();
+            if (ImGui::IsItemDeactivatedAfterEdit()) {
+                ExecuteAfterDraw<EditorSetUndoMemoryBudget>(undoMemoryBudget);
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The oldest edits are removed from the undo history when the budget is exceeded, 0 for unlimited.\n"
+                                  "The budget is applied when pressing enter or leaving the input");
+            }
+            bool enableEditJournal = editor.IsEditJournalEnabled();
+            if (ImGui::Checkbox("Crash recovery journal", &enableEditJournal)) {
+                editor.SetEditJournalEnabled(enableEditJournal);
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Write the unsaved edits to disk, they can be recovered when usdtweak restarts after a crash");
+            }
             ImGui::EndChild();
         }
     } else if (current_item == 1) {
@@ -1,12 +1,18 @@
+#include <algorithm>
 #include <array>
 #include <cctype>
 #include <iostream>
 #include <sstream>
 #include <stack>
+#include <unordered_map>
 
+#include <pxr/base/tf/hash.h>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
 #include <pxr/usd/sdf/fileFormat.h>
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/layerUtils.h>
+#include <pxr/usd/sdf/notice.h>
 #include <pxr/usd/sdf/primSpec.h>
 #include <pxr/usd/sdf/schema.h>
 #include <pxr/usd/sdf/types.h>
@@ -23,11 +29,13 @@
 #include "Editor.h"
 #include "FileBrowser.h"
 #include "ImGuiHelpers.h"
+#include "PathRowIndex.h"
 #include "SdfLayerSceneGraphEditor.h"
 #include "ModalDialogs.h"
 #include "SdfLayerEditor.h"
 #include "SdfPrimEditor.h"
 #include "Shortcuts.h"
+#include "TextFilter.h"
 #include "UsdHelpers.h"
 #include "Blueprints.h"
 
@@ -35,6 +43,83 @@
 #define LayerHierarchyEditorSeed 3456823
 #define IdOf ToImGuiID<3456823, size_t>
 
+// Changed paths kept for a layer which is not shown, above this number it is traversed again entirely
+static constexpr size_t MaxChangedPaths = 1024;
+
+///
+/// LayerHierarchyRows keeps the flattened list of the paths shown in the hierarchy of each layer, the children of a
+/// closed tree node are skipped. Only the subtrees which were opened, closed or changed in the layer since the last
+/// frame are traversed again, their rows are found with the same lazily rebuilt index as the stage outliner.
+/// The state of the tree nodes is shared by all the layers, so a layer which was not shown when a node was toggled
+/// is traversed again entirely when it is shown.
+///
+class LayerHierarchyRows : public TfWeakBase {
+  public:
+    LayerHierarchyRows() {
+        _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &LayerHierarchyRows::OnLayersDidChange);
+    }
+
+    ~LayerHierarchyRows() { TfNotice::Revoke(_noticeKey); }
+
+    /// Apply the changes which happened since the last frame and returns the paths to draw. It must be called
+    /// inside the hierarchy table to read the state of its tree nodes
+    const SdfPathVector &Update(const SdfLayerRefPtr &layer);
+
+    /// The tree node of path was opened or closed, its subtree will be traversed again in the next Update
+    void SetPathToggled(const SdfLayerHandle &layer, const SdfPath &path) {
+        LayerRows &rows = _layers[layer];
+        if (rows.toggleGeneration != _toggleGeneration) {
+            rows.needsRebuild = true;
+        }
+        rows.toggledPaths.push_back(path);
+        rows.toggleGeneration = ++_toggleGeneration;
+    }
+
+    void OnLayersDidChange(const SdfNotice::LayersDidChangeSentPerLayer &notice) {
+        for (const auto &layerChanges : notice.GetChangeListVec()) {
+            const auto found = _layers.find(layerChanges.first);
+            if (found == _layers.end()) {
+                continue;
+            }
+            LayerRows &rows = found->second;
+            if (rows.needsRebuild) {
+                continue;
+            }
+            for (const auto &pathEntry : layerChanges.second.GetEntryList()) {
+                const SdfPath &path = pathEntry.first;
+                if (path.IsAbsoluteRootPath()) {
+                    rows.needsRebuild = true;
+                } else if (path.IsPrimPath() || path.IsPrimVariantSelectionPath()) {
+                    // The children of the parent might have been added, removed, renamed or reordered
+                    rows.changedPaths.push_back(path.GetParentPath());
+                }
+            }
+            if (rows.needsRebuild || rows.changedPaths.size() > MaxChangedPaths) {
+                rows.needsRebuild = true;
+                rows.changedPaths.clear();
+            }
+        }
+    }
+
+  private:
+    struct LayerRows {
+        SdfPathVector paths;
+        PathRowIndex rowIndex;
+        SdfPathVector changedPaths;
+        SdfPathVector toggledPaths;
+        size_t toggleGeneration = 0;
+        bool needsRebuild = true;
+    };
+
+    static void _UpdateSubtrees(const SdfLayerRefPtr &layer, SdfPathVector &subtreePaths, ImGuiStorage *storage,
+                                LayerRows &rows);
+    static int _FindRow(LayerRows &rows, const SdfPath &path);
+
+    std::unordered_map<SdfLayerHandle, LayerRows, TfHash> _layers;
+    size_t _toggleGeneration = 0;
+    TfNotice::Key _noticeKey;
+};
+
 static void DrawBlueprintMenus(SdfPrimSpecHandle &primSpec, const std::string &folder) {
     Blueprints &blueprints = Blueprints::GetInstance();
     for (const auto &subfolder : blueprints.GetSubFolders(folder)) {
@@ -223,7 +308,10 @@ static void HandleDragAndDrop(SdfLayerHandle layer, const Selection &selection)
 }
 
 // Returns unfolded
-static bool DrawTreeNodePrimName(const bool &primIsVariant, SdfPrimSpecHandle &primSpec, const Selection &selection, bool hasChildren) {
+// The filtered rows are leaves, the specs which don't match the filter, shown because they are the ancestors of matching
+// specs, are dimmed
+static bool DrawTreeNodePrimName(const bool &primIsVariant, SdfPrimSpecHandle &primSpec, const Selection &selection, bool hasChildren,
+                                 LayerHierarchyRows &rows, bool isFiltered, bool isDimmed) {
     // Format text differently when the prim is a variant
     std::string primSpecName;
     if (primIsVariant) {
@@ -232,16 +320,24 @@ static bool DrawTreeNodePrimName(const bool &primIsVariant, SdfPrimSpecHandle &p
     } else {
         primSpecName = primSpec->GetPath().GetName();
     }
+    const float textAlpha = isDimmed ? 0.5f : 1.f;
     ScopedStyleColor textColor(ImGuiCol_Text,
-                               primIsVariant ? ImU32(ImColor::HSV(0.2 / 7.0f, 0.5f, 0.8f)) : ImGui::GetColorU32(ImGuiCol_Text),
+                               primIsVariant ? ImU32(ImColor::HSV(0.2 / 7.0f, 0.5f, 0.8f, textAlpha))
+                                             : ImGui::GetColorU32(ImGuiCol_Text, textAlpha),
                                ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
 
     ImGuiTreeNodeFlags nodeFlags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_AllowItemOverlap;
     nodeFlags |= hasChildren && !primSpec->HasVariantSetNames() ? ImGuiTreeNodeFlags_Leaf
                                                                 : ImGuiTreeNodeFlags_None; // ImGuiTreeNodeFlags_DefaultOpen;
+    if (isFiltered) {
+        nodeFlags |= ImGuiTreeNodeFlags_Leaf;
+    }
     ImGui::AlignTextToFramePadding();
     auto cursor = ImGui::GetCursorPos(); // Store position for the InputText to edit the prim name
     auto unfolded = ImGui::TreeNodeBehavior(IdOf(primSpec->GetPath().GetHash()), nodeFlags, primSpecName.c_str());
+    if (ImGui::IsItemToggledOpen()) {
+        rows.SetPathToggled(primSpec->GetLayer(), primSpec->GetPath());
+    }
 
     // Edition of the prim name
     static SdfPrimSpecHandle editNamePrim;
@@ -270,7 +366,7 @@ static bool DrawTreeNodePrimName(const bool &primIsVariant, SdfPrimSpecHandle &p
 
 /// Draw a node in the primspec tree
 static void DrawSdfPrimRow(const SdfLayerRefPtr &layer, const SdfPath &primPath, const Selection &selection, int nodeId,
-                           float &selectedPosY) {
+                           float &selectedPosY, LayerHierarchyRows &rows, bool isFiltered = false, bool isDimmed = false) {
     SdfPrimSpecHandle primSpec = layer->GetPrimAtPath(primPath);
 
     if (!primSpec)
@@ -302,7 +398,7 @@ static void DrawSdfPrimRow(const SdfLayerRefPtr &layer, const SdfPath &primPath,
 
     ImGui::SameLine();
     TreeIndenter<LayerHierarchyEditorSeed, SdfPath> indenter(primPath);
-    bool unfolded = DrawTreeNodePrimName(primIsVariant, primSpec, selection, childrenNames.empty());
+    bool unfolded = DrawTreeNodePrimName(primIsVariant, primSpec, selection, childrenNames.empty(), rows, isFiltered, isDimmed);
 
     // Right click will open the quick edit popup menu
     if (ImGui::BeginPopupContextItem()) {
@@ -340,7 +436,8 @@ static void DrawSdfPrimRow(const SdfLayerRefPtr &layer, const SdfPath &primPath,
     ImGui::PopID();
 }
 
-static void DrawTopNodeLayerRow(const SdfLayerRefPtr &layer, const Selection &selection, float &selectedPosY) {
+static void DrawTopNodeLayerRow(const SdfLayerRefPtr &layer, const Selection &selection, float &selectedPosY,
+                                LayerHierarchyRows &rows) {
     ImGuiTreeNodeFlags treeNodeFlags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_AllowItemOverlap;
     int nodeId = 0;
     if (layer->GetRootPrims().empty()) {
@@ -358,6 +455,9 @@ static void DrawTopNodeLayerRow(const SdfLayerRefPtr &layer, const Selection &se
     ImGui::PushStyleColor(ImGuiCol_HeaderActive, 0);
     bool unfolded = ImGui::TreeNodeBehavior(IdOf(SdfPath::AbsoluteRootPath().GetHash()), treeNodeFlags, label.c_str());
     ImGui::PopStyleColor(2);
+    if (ImGui::IsItemToggledOpen()) {
+        rows.SetPathToggled(layer, SdfPath::AbsoluteRootPath());
+    }
     
     if (!ImGui::IsItemToggledOpen() && ImGui::IsItemClicked()) {
         ExecuteAfterDraw<EditorSetSelection>(layer, SdfPath::AbsoluteRootPath());;
@@ -416,40 +516,38 @@ static void DrawTopNodeLayerRow(const SdfLayerRefPtr &layer, const Selection &se
     }
 }
 
-/// Traverse all the path of the layer and store them in a vector. Apply a filter to only traverse the path
-/// that should be displayed, the ones inside the collapsed part of the tree view
-void TraverseOpenedPaths(const SdfLayerRefPtr &layer, std::vector<SdfPath> &paths) {
-    paths.clear();
+/// Traverse the paths of the layer under rootPath, rootPath included, and append them to a vector. Apply a filter to
+/// only traverse the paths that should be displayed, skipping the ones inside the collapsed part of the tree view
+static void TraverseOpenedPaths(const SdfLayerRefPtr &layer, const SdfPath &rootPath, ImGuiStorage *storage,
+                                std::vector<SdfPath> &paths) {
     std::stack<SdfPath> st;
-    st.push(SdfPath::AbsoluteRootPath());
-    ImGuiContext &g = *GImGui;
-    ImGuiWindow *window = g.CurrentWindow;
-    ImGuiStorage *storage = window->DC.StateStorage;
+    st.push(rootPath);
     while (!st.empty()) {
         const SdfPath path = st.top();
         st.pop();
         const ImGuiID pathHash = IdOf(path.GetHash());
         const bool isOpen = storage->GetInt(pathHash, 0) != 0;
         if (isOpen) {
-            if (layer->HasField(path, SdfChildrenKeys->PrimChildren)) {
-                const std::vector<TfToken> &children =
-                    layer->GetFieldAs<std::vector<TfToken>>(path, SdfChildrenKeys->PrimChildren);
-                for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            // The children fields are read without copying the token vectors held by the VtValues
+            const VtValue children = layer->GetField(path, SdfChildrenKeys->PrimChildren);
+            if (children.IsHolding<TfTokenVector>()) {
+                const TfTokenVector &childrenNames = children.UncheckedGet<TfTokenVector>();
+                for (auto it = childrenNames.rbegin(); it != childrenNames.rend(); ++it) {
                     st.push(path.AppendChild(*it));
                 }
             }
-            if (layer->HasField(path, SdfChildrenKeys->VariantSetChildren)) {
-                const std::vector<TfToken> &variantSetchildren =
-                    layer->GetFieldAs<std::vector<TfToken>>(path, SdfChildrenKeys->VariantSetChildren);
+            const VtValue variantSetChildren = layer->GetField(path, SdfChildrenKeys->VariantSetChildren);
+            if (variantSetChildren.IsHolding<TfTokenVector>()) {
+                const TfTokenVector &variantSetNames = variantSetChildren.UncheckedGet<TfTokenVector>();
                 // Skip the variantSet paths and show only the variantSetChildren
-                for (auto vSetIt = variantSetchildren.rbegin(); vSetIt != variantSetchildren.rend(); ++vSetIt) {
+                for (auto vSetIt = variantSetNames.rbegin(); vSetIt != variantSetNames.rend(); ++vSetIt) {
                     auto variantSetPath = path.AppendVariantSelection(*vSetIt, "");
-                    if (layer->HasField(variantSetPath, SdfChildrenKeys->VariantChildren)) {
-                        const std::vector<TfToken> &variantChildren =
-                            layer->GetFieldAs<std::vector<TfToken>>(variantSetPath, SdfChildrenKeys->VariantChildren);
-                        const std::string &variantSet = variantSetPath.GetVariantSelection().first;
-                        for (auto vChildrenIt = variantChildren.rbegin(); vChildrenIt != variantChildren.rend(); ++vChildrenIt) {
-                            st.push(path.AppendVariantSelection(TfToken(variantSet), *vChildrenIt));
+                    const VtValue variantChildren = layer->GetField(variantSetPath, SdfChildrenKeys->VariantChildren);
+                    if (variantChildren.IsHolding<TfTokenVector>()) {
+                        const TfTokenVector &variantNames = variantChildren.UncheckedGet<TfTokenVector>();
+                        const TfToken variantSet(variantSetPath.GetVariantSelection().first);
+                        for (auto vChildrenIt = variantNames.rbegin(); vChildrenIt != variantNames.rend(); ++vChildrenIt) {
+                            st.push(path.AppendVariantSelection(variantSet, *vChildrenIt));
                         }
                     }
                 }
@@ -459,13 +557,143 @@ void TraverseOpenedPaths(const SdfLayerRefPtr &layer, std::vector<SdfPath> &path
     }
 }
 
-void DrawLayerPrimHierarchy(SdfLayerRefPtr layer, const Selection &selection) {
+const SdfPathVector &LayerHierarchyRows::Update(const SdfLayerRefPtr &layer) {
+    // Forget the layers which were released
+    for (auto it = _layers.begin(); it != _layers.end();) {
+        it = it->first ? std::next(it) : _layers.erase(it);
+    }
+    LayerRows &rows = _layers[layer];
+    if (rows.toggleGeneration != _toggleGeneration) {
+        // Tree nodes were toggled while another layer was shown
+        rows.needsRebuild = true;
+        rows.toggleGeneration = _toggleGeneration;
+    }
+    ImGuiContext &g = *GImGui;
+    ImGuiWindow *window = g.CurrentWindow;
+    ImGuiStorage *storage = window->DC.StateStorage;
+    if (rows.needsRebuild) {
+        rows.paths.clear();
+        rows.rowIndex.Invalidate();
+        TraverseOpenedPaths(layer, SdfPath::AbsoluteRootPath(), storage, rows.paths);
+    } else if (!rows.changedPaths.empty() || !rows.toggledPaths.empty()) {
+        SdfPathVector subtreePaths(rows.changedPaths);
+        subtreePaths.insert(subtreePaths.end(), rows.toggledPaths.begin(), rows.toggledPaths.end());
+        _UpdateSubtrees(layer, subtreePaths, storage, rows);
+    }
+    rows.needsRebuild = false;
+    rows.changedPaths.clear();
+    rows.toggledPaths.clear();
+    return rows.paths;
+}
+
+// Traverse again the subtrees of the rows of the paths, when they are visible. The descendants of a path follow its
+// row, the paths inside another subtree are skipped and the rows are copied once to a new vector with the new subtrees
+void LayerHierarchyRows::_UpdateSubtrees(const SdfLayerRefPtr &layer, SdfPathVector &subtreePaths, ImGuiStorage *storage,
+                                         LayerRows &rows) {
+    SdfPath::RemoveDescendentPaths(&subtreePaths);
+    std::vector<std::pair<int, SdfPath>> subtrees;
+    for (const SdfPath &path : subtreePaths) {
+        const int rowIndex = _FindRow(rows, path);
+        if (rowIndex >= 0) {
+            subtrees.emplace_back(rowIndex, path);
+        }
+    }
+    if (subtrees.empty()) {
+        return;
+    }
+    std::sort(subtrees.begin(), subtrees.end(),
+              [](const std::pair<int, SdfPath> &a, const std::pair<int, SdfPath> &b) { return a.first < b.first; });
+    SdfPathVector paths;
+    paths.reserve(rows.paths.size());
+    size_t nextRow = 0;
+    for (const auto &subtree : subtrees) {
+        const SdfPath &path = subtree.second;
+        paths.insert(paths.end(), rows.paths.begin() + nextRow, rows.paths.begin() + subtree.first);
+        // Skip the previous subtree, the row itself is traversed again as it might have been removed
+        nextRow = subtree.first + 1;
+        while (nextRow < rows.paths.size() && rows.paths[nextRow].HasPrefix(path)) {
+            ++nextRow;
+        }
+        if (layer->HasSpec(path)) {
+            TraverseOpenedPaths(layer, path, storage, paths);
+        }
+    }
+    paths.insert(paths.end(), rows.paths.begin() + nextRow, rows.paths.end());
+    rows.paths.swap(paths);
+    rows.rowIndex.Invalidate();
+}
+
+int LayerHierarchyRows::_FindRow(LayerRows &rows, const SdfPath &path) {
+    return rows.rowIndex.Find(path, rows.paths, [](const SdfPath &rowPath) -> const SdfPath & { return rowPath; });
+}
+
+///
+/// LayerHierarchyFilter holds the name filter of the layer hierarchy. The specs matching the filter are found by a
+/// LayerSearch with their ancestors, the hierarchy shows them instead of its opened paths while the filter is active.
+///
+class LayerHierarchyFilter {
+  public:
+    bool IsActive() const { return _nameFilter.IsActive(); }
+
+    void Draw() {
+        const ImGuiID nameFilterHash = _nameFilter.GetHash();
+        _nameFilter.Draw("##LayerHierarchyFilter", ImGui::GetCurrentWindow()->Size[0] - ImGui::GetFontSize() * 14);
+        _hasChanged |= nameFilterHash != _nameFilter.GetHash();
+    }
+
+    /// Start the search again when the filter or the layer have changed, or when the layer was changed after the last
+    /// search
+    void Update(const SdfLayerRefPtr &layer, LayerSearch &layerFilter) {
+        if (SdfLayerHandle(layer) != _layer) {
+            _layer = layer;
+            _hasChanged = true;
+        }
+        if (!_hasChanged && !layerFilter.IsStale()) {
+            return;
+        }
+        _hasChanged = false;
+        if (IsActive()) {
+            layerFilter.Start(layer, _MakeSpecPathMatcher());
+        } else {
+            layerFilter.Cancel();
+            layerFilter.Clear();
+        }
+    }
+
+  private:
+    // The matcher is called by the search threads, it works on a copy of the filter
+    SpecPathMatcher _MakeSpecPathMatcher() const {
+        auto nameFilter = std::make_shared<TextFilter>(_nameFilter);
+        nameFilter->Build(); // The filter ranges must point to the copied text
+        return [nameFilter](const SdfPath &path) {
+            const std::string &name =
+                path.IsPrimVariantSelectionPath() ? path.GetVariantSelection().second : path.GetName();
+            return nameFilter->PassFilter(name.c_str());
+        };
+    }
+
+    TextFilter _nameFilter;
+    bool _hasChanged = false;
+    SdfLayerHandle _layer;
+};
+
+void DrawLayerPrimHierarchy(SdfLayerRefPtr layer, const Selection &selection, LayerSearch &layerFilter) {
 
     if (!layer)
         return;
 
     SdfPrimSpecHandle selectedPrim = layer->GetPrimAtPath(selection.GetAnchorPrimPath(layer));
     DrawLayerNavigation(layer);
+
+    // The filtered hierarchy replaces the tree once the filter has found its results
+    static LayerHierarchyFilter hierarchyFilter;
+    hierarchyFilter.Draw();
+    hierarchyFilter.Update(layer, layerFilter);
+    const bool showFilteredPaths = hierarchyFilter.IsActive();
+    if (showFilteredPaths && layerFilter.IsRunning()) {
+        ImGui::SameLine();
+        ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), ImVec2(ImGui::GetFontSize() * 4, 0.f), "");
+    }
     auto flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollX | ImGuiTableFlags_ScrollY;
 
     ImGuiContext& g = *GImGui;
@@ -480,26 +708,40 @@ void DrawLayerPrimHierarchy(SdfLayerRefPtr layer, const Selection &selection) {
 
         ImGui::TableHeadersRow();
 
-        std::vector<SdfPath> paths;
+        // Each layer keeps its scroll position when another layer is shown
+        static std::unordered_map<SdfLayerHandle, float, TfHash> scrollPositions;
+        static SdfLayerHandle lastLayer;
+        if (SdfLayerHandle(layer) != lastLayer) {
+            for (auto it = scrollPositions.begin(); it != scrollPositions.end();) {
+                it = it->first ? std::next(it) : scrollPositions.erase(it);
+            }
+            const auto found = scrollPositions.find(layer);
+            ImGui::SetScrollY(found != scrollPositions.end() ? found->second : 0.f);
+            lastLayer = layer;
+        } else {
+            scrollPositions[layer] = ImGui::GetScrollY();
+        }
 
-        // Find all the opened paths
-        paths.reserve(1024);
-        TraverseOpenedPaths(layer, paths);
+        // Find all the opened paths, or the paths matching the filter which are shown below the layer row
+        static LayerHierarchyRows *layerRows = new LayerHierarchyRows();
+        const SdfPathVector &paths = showFilteredPaths ? layerFilter.GetResults() : layerRows->Update(layer);
+        const int firstPathRow = showFilteredPaths ? 1 : 0;
 
         int nodeId = 0;
         float selectedPosY = -1;
-        const size_t arraySize = paths.size();
+        const size_t arraySize = paths.size() + firstPathRow;
         SdfPathVector pathPrefixes;
         ImGuiListClipper clipper;
         clipper.Begin(static_cast<int>(arraySize));
         while (clipper.Step()) {
             for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
                 ImGui::PushID(row);
-                const SdfPath &path = paths[row];
+                const SdfPath &path = row < firstPathRow ? SdfPath::AbsoluteRootPath() : paths[row - firstPathRow];
                 if (path.IsAbsoluteRootPath()) {
-                    DrawTopNodeLayerRow(layer, selection, selectedPosY);
+                    DrawTopNodeLayerRow(layer, selection, selectedPosY, *layerRows);
                 } else {
-                    DrawSdfPrimRow(layer, path, selection, row, selectedPosY);
+                    DrawSdfPrimRow(layer, path, selection, row, selectedPosY, *layerRows, showFilteredPaths,
+                                   showFilteredPaths && !layerFilter.IsMatching(path));
                 }
                 ImGui::PopID();
             }
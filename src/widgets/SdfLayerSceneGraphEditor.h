@@ -3,10 +3,11 @@
 #include <pxr/usd/sdf/layer.h>
 #include <pxr/usd/sdf/primSpec.h>
 
+#include "LayerSearch.h"
 #include "Selection.h"
 
 // rename to SdfLayerSceneGraphEditor.h ??
 // DrawLayerSceneGraph ??
 
-void DrawLayerPrimHierarchy(SdfLayerRefPtr layer, const Selection &selectedPrim);
+void DrawLayerPrimHierarchy(SdfLayerRefPtr layer, const Selection &selectedPrim, LayerSearch &layerFilter);
 
@@ -54,7 +54,7 @@ static void DrawLayerSublayerTreeNodeButtons(const SdfLayerRefPtr &layer, const
     ScopedStyleColor transparentButtons(ImGuiCol_Button, ImVec4(ColorTransparent));
     ImGui::BeginDisabled(!layer || !layer->IsDirty() || layer->IsAnonymous());
     if (ImGui::Button(ICON_FA_SAVE)) {
-        ExecuteAfterDraw(&SdfLayer::Save, layer, false);
+        ExecuteAfterDraw<EditorSaveLayer>(layer);
     }
     // TODO it would be useful to have an option to save all the modified children
     ImGui::EndDisabled();
@@ -1,19 +1,32 @@
+#include <algorithm>
+#include <functional>
 #include <iostream>
 
+#include <unordered_map>
 #include <vector>
 
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/kind/registry.h>
 #include <pxr/usd/pcp/layerStack.h>
+#include <pxr/usd/pcp/primIndex.h>
+#include <pxr/usd/usd/modelAPI.h>
+#include <pxr/usd/usd/notice.h>
 #include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usd/stagePopulationMask.h>
 #include <pxr/usd/usdGeom/gprim.h>
 
 #include "Commands.h"
 #include "Constants.h"
 #include "Gui.h"
 #include "ImGuiHelpers.h"
+#include "PathRowIndex.h"
 #include "UsdPrimEditor.h" // for DrawUsdPrimEditTarget
 #include "StageOutliner.h"
+#include "TextFilter.h"
 #include "VtValueEditor.h"
 #include "ConnectionEditor.h"
+#include "WildcardsCompare.h"
 
 
 #define StageOutlinerSeed 2342934
@@ -78,6 +91,320 @@ class StageOutlinerDisplayOptions {
     bool _showPrototypes = true;
 };
 
+///
+/// InstanceProxyPaths keeps alive the paths of the instance proxies opened in the outliner.
+///
+/// It appears that the SdfPath of instance proxies are not kept and the underlying memory is deleted and recreated
+/// between each frame, invalidating the hash value. So for the same path we have different hash every frame and the
+/// tree node state stored with the hash is lost.
+/// This problems appears on versions > 21.11
+/// a look at the changelog shows that they were lots of changes on the SdfPath side:
+/// https://github.com/PixarAnimationStudios/USD/commit/46c26f63d2a6e9c6c5dbfbcefa0235c3265457bb
+///
+/// The paths shown in the outliner are kept by its rows, only the opened ones need to stay alive when they are hidden
+/// under a closed parent. They are released when their stage is closed, and the least recently traversed are released
+/// when a stage has more than MaxPathsPerStage, closing their tree nodes. The paths which have a row are never released.
+///
+class InstanceProxyPaths {
+  public:
+    static constexpr size_t MaxPathsPerStage = 50000;
+
+    /// Select the paths of the stage, and release the paths of the closed stages
+    void SetStage(const UsdStageRefPtr &stage) {
+        ReleaseClosedStages();
+        _current = _FindStage(get_pointer(stage));
+        if (_current < 0 && stage) {
+            _stages.push_back({stage, {}});
+            _current = static_cast<int>(_stages.size()) - 1;
+        }
+    }
+
+    /// Release the paths of the stages which were closed, it is called at each update as a closed stage might
+    /// not be selected again
+    void ReleaseClosedStages() {
+        const auto isClosed = [](const StagePaths &stagePaths) { return !stagePaths.stage; };
+        if (std::none_of(_stages.begin(), _stages.end(), isClosed)) {
+            return;
+        }
+        const UsdStage *current = _current >= 0 ? get_pointer(_stages[_current].stage) : nullptr;
+        _stages.erase(std::remove_if(_stages.begin(), _stages.end(), isClosed), _stages.end());
+        _current = _FindStage(current);
+    }
+
+    /// Keep the path of an opened instance proxy alive
+    void Retain(const SdfPath &path) {
+        if (_current >= 0) {
+            _stages[_current].lastTraversals[path] = _traversal;
+        }
+    }
+
+    /// Called after the rows were traversed, releases the oldest paths if there are too many. The paths for which
+    /// hasRow returns true are kept, the released paths are appended to releasedPaths as their tree nodes are closed
+    void EndTraversal(ImGuiStorage *storage, const std::function<bool(const SdfPath &)> &hasRow,
+                      SdfPathVector &releasedPaths) {
+        ++_traversal;
+        if (_current < 0 || _stages[_current].lastTraversals.size() <= MaxPathsPerStage) {
+            return;
+        }
+        // Release a quarter of the paths at once to not sort them at each traversal
+        auto &lastTraversals = _stages[_current].lastTraversals;
+        std::vector<std::unordered_map<SdfPath, size_t, SdfPath::Hash>::iterator> candidates;
+        candidates.reserve(lastTraversals.size());
+        for (auto it = lastTraversals.begin(); it != lastTraversals.end(); ++it) {
+            if (!hasRow(it->first)) {
+                candidates.push_back(it);
+            }
+        }
+        const size_t released = std::min(lastTraversals.size() - MaxPathsPerStage * 3 / 4, candidates.size());
+        std::nth_element(candidates.begin(), candidates.begin() + released, candidates.end(),
+                         [](const auto &a, const auto &b) { return a->second < b->second; });
+        for (size_t i = 0; i < released; ++i) {
+            // The hash of the path could be reused by another path, its tree node is closed
+            storage->SetInt(IdOf(GetHash(candidates[i]->first)), 0);
+            releasedPaths.push_back(candidates[i]->first);
+            lastTraversals.erase(candidates[i]);
+        }
+    }
+
+  private:
+    struct StagePaths {
+        UsdStageWeakPtr stage;
+        std::unordered_map<SdfPath, size_t, SdfPath::Hash> lastTraversals;
+    };
+
+    int _FindStage(const UsdStage *stage) const {
+        if (!stage) {
+            return -1;
+        }
+        const auto found = std::find_if(_stages.begin(), _stages.end(), [stage](const StagePaths &stagePaths) {
+            return get_pointer(stagePaths.stage) == stage;
+        });
+        return found == _stages.end() ? -1 : static_cast<int>(found - _stages.begin());
+    }
+
+    std::vector<StagePaths> _stages;
+    int _current = -1;
+    size_t _traversal = 0;
+};
+
+///
+/// StageOutlinerRows is the flattened list of the prims shown in the outliner, the children of a closed tree node
+/// are skipped. It is kept between frames, only the subtrees which were opened, closed or resynced since the last
+/// frame are traversed again, so the cost of a frame without changes depends only on the number of visible rows.
+/// The row of a path is found with an index rebuilt lazily after the rows have changed.
+///
+class StageOutlinerRows : public TfWeakBase {
+  public:
+    struct Row {
+        SdfPath path;
+        bool isLeaf; // no children passing the display predicate
+    };
+
+    StageOutlinerRows() {
+        _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &StageOutlinerRows::OnObjectsChanged);
+    }
+
+    ~StageOutlinerRows() { TfNotice::Revoke(_noticeKey); }
+
+    /// Apply the changes which happened since the last frame. It must be called inside the outliner table
+    /// to read the state of its tree nodes
+    void Update(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions);
+
+    /// The tree node of path was opened or closed, its subtree will be traversed again in the next Update
+    void SetPathToggled(const SdfPath &path) { _toggledPaths.push_back(path); }
+
+    /// Traverse the whole stage again in the next Update
+    void SetNeedsRebuild() { _needsRebuild = true; }
+
+    const std::vector<Row> &GetRows() const { return _rows; }
+
+    /// Returns the row of path, or -1 if it is not shown
+    int FindRow(const SdfPath &path);
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice) {
+        if (notice.GetStage() != _stage) {
+            return;
+        }
+        // The info only changes don't modify the hierarchy, the rows read the values when they are drawn
+        for (const SdfPath &path : notice.GetResyncedPaths()) {
+            if (path.IsAbsoluteRootOrPrimPath()) {
+                _resyncedPaths.push_back(path);
+            }
+        }
+    }
+
+  private:
+    void _UpdateSubtrees(SdfPathVector &paths, ImGuiStorage *storage);
+    void _TraverseRange(UsdPrimRange::iterator iter, const UsdPrimRange::iterator &end, ImGuiStorage *storage,
+                        std::vector<Row> &rows);
+
+    UsdStageWeakPtr _stage;
+    Usd_PrimFlagsPredicate _predicate;
+    bool _showPrototypes = true;
+    std::vector<Row> _rows;
+    PathRowIndex _rowIndex;
+    SdfPathVector _resyncedPaths;
+    SdfPathVector _toggledPaths;
+    bool _needsRebuild = true;
+    InstanceProxyPaths _instanceProxyPaths;
+    TfNotice::Key _noticeKey;
+};
+
+///
+/// PrimRowInfoCache keeps the values drawn in the rows of the outliner which are costly to read from the stage: the
+/// color computed from the composition arcs and the visibility. They are read when a row is first drawn and are
+/// forgotten when the prim changes, so scrolling through the rows doesn't resolve the attributes every frame.
+/// Only the visible rows are needed, the cache is cleared when it grows bigger than MaxCachedRows.
+///
+class PrimRowInfoCache : public TfWeakBase {
+  public:
+    static constexpr size_t MaxCachedRows = 8192;
+    // Each resynced path scans the whole cache, the cache is cleared when a notice has more resynced paths
+    static constexpr size_t MaxScannedResyncs = 16;
+
+    struct PrimRowInfo {
+        ImVec4 color;
+        TfToken visibility;
+        bool isImageable;
+        bool hasAuthoredVisibility;
+    };
+
+    PrimRowInfoCache() { _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &PrimRowInfoCache::OnObjectsChanged); }
+
+    ~PrimRowInfoCache() { TfNotice::Revoke(_noticeKey); }
+
+    void SetStage(const UsdStageRefPtr &stage) {
+        if (get_pointer(stage) != get_pointer(_stage)) {
+            _stage = stage;
+            _infos.clear();
+        }
+    }
+
+    /// The returned reference is valid until the next call
+    const PrimRowInfo &Get(const UsdPrim &prim);
+
+    void OnObjectsChanged(const UsdNotice::ObjectsChanged &notice);
+
+  private:
+    UsdStageWeakPtr _stage;
+    std::unordered_map<SdfPath, PrimRowInfo, SdfPath::Hash> _infos;
+    TfNotice::Key _noticeKey;
+};
+
+///
+/// StageOutlinerFilter holds the settings of the outliner filter. The prims matching the name, type, kind and purpose
+/// are found by a PrimSearch with their ancestors, the outliner shows them instead of its rows while the filter is active.
+///
+class StageOutlinerFilter {
+  public:
+    bool IsActive() const { return _nameFilter.IsActive() || _typeName[0] != 0 || !_kind.IsEmpty() || !_purpose.IsEmpty(); }
+
+    void Draw();
+
+    /// Start the search again when the settings, the stage or the display predicate have changed, or when the
+    /// stage was resynced after the last search
+    void Update(const UsdStageRefPtr &stage, const Usd_PrimFlagsPredicate &predicate, PrimSearch &primFilter);
+
+  private:
+    PrimMatcher _MakePrimMatcher() const;
+
+    TextFilter _nameFilter;
+    char _typeName[128] = {0};
+    TfToken _kind;
+    TfToken _purpose;
+    bool _hasChanged = false;
+    UsdStageWeakPtr _stage;
+    Usd_PrimFlagsPredicate _predicate = UsdPrimDefaultPredicate;
+};
+
+void StageOutlinerFilter::Draw() {
+    const ImGuiContext &g = *GImGui;
+    const ImGuiID nameFilterHash = _nameFilter.GetHash();
+    _nameFilter.Draw("##OutlinerFilter", ImGui::GetCurrentWindow()->Size[0] - g.FontSize * 30);
+    _hasChanged |= nameFilterHash != _nameFilter.GetHash();
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(g.FontSize * 7);
+    _hasChanged |= ImGui::InputTextWithHint("##OutlinerFilterType", "Type", _typeName, IM_ARRAYSIZE(_typeName));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(g.FontSize * 6);
+    if (ImGui::BeginCombo("##OutlinerFilterKind", _kind.IsEmpty() ? "Any kind" : _kind.GetText())) {
+        if (ImGui::Selectable("Any kind", _kind.IsEmpty())) {
+            _kind = TfToken();
+            _hasChanged = true;
+        }
+        for (const TfToken &kind : KindRegistry::GetInstance().GetAllKinds()) {
+            if (ImGui::Selectable(kind.GetText(), kind == _kind)) {
+                _kind = kind;
+                _hasChanged = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(g.FontSize * 6);
+    if (ImGui::BeginCombo("##OutlinerFilterPurpose", _purpose.IsEmpty() ? "Any purpose" : _purpose.GetText())) {
+        if (ImGui::Selectable("Any purpose", _purpose.IsEmpty())) {
+            _purpose = TfToken();
+            _hasChanged = true;
+        }
+        for (const TfToken &purpose : UsdGeomImageable::GetOrderedPurposeTokens()) {
+            if (ImGui::Selectable(purpose.GetText(), purpose == _purpose)) {
+                _purpose = purpose;
+                _hasChanged = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+}
+
+// The matcher is called by the search threads, it works on copies of the settings
+PrimMatcher StageOutlinerFilter::_MakePrimMatcher() const {
+    auto nameFilter = std::make_shared<TextFilter>(_nameFilter);
+    nameFilter->Build(); // The filter ranges must point to the copied text
+    const std::string typeName(_typeName);
+    const TfToken kind = _kind;
+    const TfToken purpose = _purpose;
+    return [nameFilter, typeName, kind, purpose](const UsdPrim &prim) {
+        if (!nameFilter->PassFilter(prim.GetName().GetText())) {
+            return false;
+        }
+        if (!typeName.empty() && !FastWildComparePortable(typeName.c_str(), prim.GetTypeName().GetText())) {
+            return false;
+        }
+        if (!kind.IsEmpty()) {
+            TfToken primKind;
+            if (!UsdModelAPI(prim).GetKind(&primKind) || !KindRegistry::GetInstance().IsA(primKind, kind)) {
+                return false;
+            }
+        }
+        if (!purpose.IsEmpty()) {
+            UsdGeomImageable imageable(prim);
+            if (!imageable || imageable.ComputePurpose() != purpose) {
+                return false;
+            }
+        }
+        return true;
+    };
+}
+
+void StageOutlinerFilter::Update(const UsdStageRefPtr &stage, const Usd_PrimFlagsPredicate &predicate, PrimSearch &primFilter) {
+    if (get_pointer(stage) != get_pointer(_stage) || !(predicate == _predicate)) {
+        _stage = stage;
+        _predicate = predicate;
+        _hasChanged = true;
+    }
+    if (!_hasChanged && !primFilter.IsStale()) {
+        return;
+    }
+    _hasChanged = false;
+    if (IsActive()) {
+        primFilter.Start(stage, _MakePrimMatcher(), predicate, true);
+    } else {
+        primFilter.Cancel();
+        primFilter.Clear();
+    }
+}
+
 static void ExploreLayerTree(SdfLayerTreeHandle tree, PcpNodeRef node) {
     if (!tree)
         return;
@@ -102,7 +429,51 @@ static void ExploreComposition(PcpNodeRef root) {
     TF_FOR_ALL(childNode, root.GetChildrenRange()) { ExploreComposition(*childNode); }
 }
 
-static void DrawUsdPrimEditMenuItems(const UsdPrim &prim) {
+// The stage subset is its population mask, it is grown and shrunk without reopening the stage.
+// The children outside of the mask are not composed, their names are found in the prim index
+static void DrawStageSubsetMenuItems(const UsdPrim &prim, const Selection &selectedPaths) {
+    const UsdStageWeakPtr stage = prim.GetStage();
+    if (ImGui::MenuItem("Open a subset with the selected prims")) {
+        SdfPathVector paths = selectedPaths.GetSelectedPaths(UsdStageRefPtr(stage));
+        if (std::find(paths.begin(), paths.end(), prim.GetPath()) == paths.end()) {
+            paths = {prim.GetPath()};
+        }
+        ExecuteAfterDraw<EditorOpenStageSubset>(stage, paths);
+    }
+    if (prim.IsInstanceProxy()) {
+        return;
+    }
+    const UsdStagePopulationMask mask = stage->GetPopulationMask();
+    const bool isMasked = !mask.IncludesSubtree(SdfPath::AbsoluteRootPath());
+    if (isMasked && !mask.IncludesSubtree(prim.GetPath())) {
+        if (ImGui::MenuItem("Add to the subset")) {
+            ExecuteAfterDraw<EditorAddToPopulationMask>(stage, prim.GetPath());
+        }
+        if (ImGui::BeginMenu("Add a child to the subset")) {
+            TfTokenVector childNames;
+            PcpTokenSet prohibitedNames;
+            prim.GetPrimIndex().ComputePrimChildNames(&childNames, &prohibitedNames);
+            for (const TfToken &childName : childNames) {
+                const SdfPath childPath = prim.GetPath().AppendChild(childName);
+                if (!mask.IncludesSubtree(childPath) && ImGui::MenuItem(childName.GetText())) {
+                    ExecuteAfterDraw<EditorAddToPopulationMask>(stage, childPath);
+                }
+            }
+            ImGui::EndMenu();
+        }
+    }
+    if (!prim.IsPseudoRoot() && ImGui::MenuItem("Remove from the subset")) {
+        ExecuteAfterDraw<EditorRemoveFromPopulationMask>(stage, prim.GetPath());
+    }
+    if (ImGui::MenuItem("Add the relationship targets to the subset")) {
+        ExecuteAfterDraw<EditorExpandPopulationMask>(stage);
+    }
+    if (isMasked && ImGui::MenuItem("Show the whole stage")) {
+        ExecuteAfterDraw<EditorAddToPopulationMask>(stage, SdfPath::AbsoluteRootPath());
+    }
+}
+
+static void DrawUsdPrimEditMenuItems(const UsdPrim &prim, const Selection &selectedPaths) {
     if (ImGui::MenuItem("Toggle active")) {
         const bool active = !prim.IsActive();
         ExecuteAfterDraw(&UsdPrim::SetActive, prim, active);
@@ -114,9 +485,19 @@ static void DrawUsdPrimEditMenuItems(const UsdPrim &prim) {
     if (prim.HasAuthoredPayloads() && !prim.IsLoaded() && ImGui::MenuItem("Load")) {
         ExecuteAfterDraw(&UsdPrim::Load, prim, UsdLoadWithDescendants);
     }
+    if (ImGui::MenuItem("Select descendants")) {
+        ExecuteAfterDraw<EditorSelectDescendants>(prim.GetStage(), prim.GetPath());
+    }
+    if (ImGui::MenuItem("Add descendants to selection")) {
+        ExecuteAfterDraw<EditorSelectDescendants>(prim.GetStage(), prim.GetPath(), true);
+    }
     if (ImGui::MenuItem("Copy prim path")) {
         ImGui::SetClipboardText(prim.GetPath().GetString().c_str());
     }
+    if (ImGui::BeginMenu("Stage subset")) {
+        DrawStageSubsetMenuItems(prim, selectedPaths);
+        ImGui::EndMenu();
+    }
     if (ImGui::BeginMenu("Edit layer")) {
         auto pcpIndex = prim.ComputeExpandedPrimIndex();
         if (pcpIndex.IsValid()) {
@@ -160,6 +541,58 @@ static ImVec4 GetPrimColor(const UsdPrim &prim) {
     return ImVec4(ColorPrimDefault);
 }
 
+const PrimRowInfoCache::PrimRowInfo &PrimRowInfoCache::Get(const UsdPrim &prim) {
+    const auto found = _infos.find(prim.GetPath());
+    if (found != _infos.end()) {
+        return found->second;
+    }
+    if (_infos.size() >= MaxCachedRows) {
+        _infos.clear();
+    }
+    PrimRowInfo info{GetPrimColor(prim), TfToken(), false, false};
+    UsdGeomImageable imageable(prim);
+    if (imageable) {
+        // TODO: this should work with animation
+        auto attr = imageable.GetVisibilityAttr();
+        VtValue visibleValue;
+        attr.Get(&visibleValue);
+        info.visibility = visibleValue.Get<TfToken>();
+        info.isImageable = true;
+        info.hasAuthoredVisibility = attr.HasAuthoredValue();
+    }
+    return _infos.emplace(prim.GetPath(), info).first->second;
+}
+
+void PrimRowInfoCache::OnObjectsChanged(const UsdNotice::ObjectsChanged &notice) {
+    if (notice.GetStage() != _stage) {
+        return;
+    }
+    // A resync can change the composition arcs of the whole subtree
+    const auto resyncedPaths = notice.GetResyncedPaths();
+    if (resyncedPaths.size() > MaxScannedResyncs) {
+        _infos.clear();
+        return;
+    }
+    for (const SdfPath &path : resyncedPaths) {
+        // The instance proxies of a prototype are under all its instances
+        if (path.IsAbsoluteRootPath() || UsdPrim::IsPathInPrototype(path)) {
+            _infos.clear();
+            return;
+        }
+        const SdfPath primPath = path.GetPrimPath();
+        for (auto it = _infos.begin(); it != _infos.end();) {
+            it = it->first.HasPrefix(primPath) ? _infos.erase(it) : std::next(it);
+        }
+    }
+    for (const SdfPath &path : notice.GetChangedInfoOnlyPaths()) {
+        if (UsdPrim::IsPathInPrototype(path)) {
+            _infos.clear();
+            return;
+        }
+        _infos.erase(path.GetPrimPath());
+    }
+}
+
 static inline const char *GetVisibilityIcon(const TfToken &visibility) {
     if (visibility == UsdGeomTokens->inherited) {
         return ICON_FA_HAND_POINT_UP;
@@ -171,25 +604,19 @@ static inline const char *GetVisibilityIcon(const TfToken &visibility) {
     return ICON_FA_EYE;
 }
 
-static void DrawVisibilityButton(const UsdPrim &prim) {
-    // TODO: this should work with animation
-    UsdGeomImageable imageable(prim);
-    if (imageable) {
+static void DrawVisibilityButton(const UsdPrim &prim, const PrimRowInfoCache::PrimRowInfo &info) {
+    if (info.isImageable) {
         ImGui::PushID(IdOf(prim.GetPath().GetHash()));
-        // Get visibility value
-        auto attr = imageable.GetVisibilityAttr();
-        VtValue visibleValue;
-        attr.Get(&visibleValue);
-        TfToken visibilityToken = visibleValue.Get<TfToken>();
-        const char *visibilityIcon = GetVisibilityIcon(visibilityToken);
+        const char *visibilityIcon = GetVisibilityIcon(info.visibility);
         {
             ScopedStyleColor buttonColor(
-                ImGuiCol_Text, attr.HasAuthoredValue() ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorPrimInactive));
+                ImGuiCol_Text, info.hasAuthoredVisibility ? ImVec4(1.0, 1.0, 1.0, 1.0) : ImVec4(ColorPrimInactive));
             ImGui::SmallButton(visibilityIcon);
             // Menu to select the new visibility
             {
                 ScopedStyleColor menuTextColor(ImGuiCol_Text, ImVec4(1.0, 1.0, 1.0, 1.0));
                 if (ImGui::BeginPopupContextItem(nullptr, ImGuiPopupFlags_MouseButtonLeft)) {
+                    auto attr = UsdGeomImageable(prim).GetVisibilityAttr();
                     if (attr.HasAuthoredValue() && ImGui::MenuItem("clear visibiliy")) {
                         ExecuteAfterDraw(&UsdPrim::RemoveProperty, prim, attr.GetName());
                     }
@@ -227,14 +654,14 @@ static void DrawBackgroundSelection(const UsdPrim &prim, bool selected) {
 
 
 
-static void DrawPrimTreeRow(const UsdPrim &prim, Selection &selectedPaths, StageOutlinerDisplayOptions &displayOptions) {
+// The prims which don't match the filter, shown because they are the ancestors of matching prims, are dimmed
+static void DrawPrimTreeRow(const UsdPrim &prim, bool isLeaf, const PrimRowInfoCache::PrimRowInfo &info,
+                            Selection &selectedPaths, StageOutlinerRows &rows, bool isDimmed = false) {
     ImGuiTreeNodeFlags flags =
         ImGuiTreeNodeFlags_OpenOnArrow |
         ImGuiTreeNodeFlags_AllowItemOverlap; // for testing worse case scenario add | ImGuiTreeNodeFlags_DefaultOpen;
 
-    // Another way ???
-    const auto &children = prim.GetFilteredChildren(displayOptions.GetPrimFlagsPredicate());
-    if (children.empty()) {
+    if (isLeaf) {
         flags |= ImGuiTreeNodeFlags_Leaf;
     }
 
@@ -245,10 +672,17 @@ static void DrawPrimTreeRow(const UsdPrim &prim, Selection &selectedPaths, Stage
     {
         {
             TreeIndenter<StageOutlinerSeed, SdfPath> indenter(prim.GetPath());
-            ScopedStyleColor primColor(ImGuiCol_Text, GetPrimColor(prim), ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
+            ImVec4 textColor = info.color;
+            if (isDimmed) {
+                textColor.w *= 0.5f;
+            }
+            ScopedStyleColor primColor(ImGuiCol_Text, textColor, ImGuiCol_HeaderHovered, 0, ImGuiCol_HeaderActive, 0);
             const ImGuiID pathHash = IdOf(GetHash(prim.GetPath()));
             //ImGui::AlignTextToFramePadding();
             unfolded = ImGui::TreeNodeBehavior(pathHash, flags, prim.GetName().GetText());
+            if (ImGui::IsItemToggledOpen()) {
+                rows.SetPathToggled(prim.GetPath());
+            }
             // TreeSelectionBehavior(selectedPaths, &prim);
             if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
                 // TODO selection, should go in commands, ultimately the selection is passed
@@ -267,13 +701,13 @@ static void DrawPrimTreeRow(const UsdPrim &prim, Selection &selectedPaths, Stage
         {
             ScopedStyleColor popupColor(ImGuiCol_Text, ImVec4(ColorPrimDefault));
             if (ImGui::BeginPopupContextItem()) {
-                DrawUsdPrimEditMenuItems(prim);
+                DrawUsdPrimEditMenuItems(prim, selectedPaths);
                 ImGui::EndPopup();
             }
         }
         // Visibility
         ImGui::TableSetColumnIndex(1);
-        DrawVisibilityButton(prim);
+        DrawVisibilityButton(prim, info);
 
         // Type
         ImGui::TableSetColumnIndex(2);
@@ -284,13 +718,16 @@ static void DrawPrimTreeRow(const UsdPrim &prim, Selection &selectedPaths, Stage
     }
 }
 
-static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPaths) {
+static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPaths, StageOutlinerRows &rows) {
     ImGui::TableNextRow();
     ImGui::TableSetColumnIndex(0);
 
     ImGuiTreeNodeFlags nodeflags = ImGuiTreeNodeFlags_OpenOnArrow;
     std::string stageDisplayName(stage->GetRootLayer()->GetDisplayName());
     auto unfolded = ImGui::TreeNodeBehavior(IdOf(GetHash(SdfPath::AbsoluteRootPath())), nodeflags, stageDisplayName.c_str());
+    if (ImGui::IsItemToggledOpen()) {
+        rows.SetNeedsRebuild();
+    }
 
     ImGui::TableSetColumnIndex(2);
     ImGui::SmallButton(ICON_FA_PEN);
@@ -309,80 +746,225 @@ static void DrawStageTreeRow(const UsdStageRefPtr &stage, Selection &selectedPat
 
 /// This function should be called only when the Selection has changed
 /// It modifies the internal imgui tree graph state.
-static void OpenSelectedPaths(const UsdStageRefPtr &stage, Selection &selectedPaths) {
+static void OpenSelectedPaths(const UsdStageRefPtr &stage, Selection &selectedPaths, StageOutlinerRows &rows) {
     ImGuiContext &g = *GImGui;
     ImGuiWindow *window = g.CurrentWindow;
     ImGuiStorage *storage = window->DC.StateStorage;
     for (const auto &path : selectedPaths.GetSelectedPaths(stage)) {
         for (const auto &element : path.GetParentPath().GetPrefixes()) {
             ImGuiID id = IdOf(GetHash(element)); // This has changed with the optim one
-            storage->SetInt(id, true);
+            if (storage->GetInt(id, 0) == 0) {
+                storage->SetInt(id, true);
+                rows.SetPathToggled(element);
+            }
         }
     }
 }
 
-static void TraverseRange(UsdPrimRange &range, std::vector<SdfPath> &paths) {
-    static std::set<SdfPath> retainedPath; // to fix a bug with instanced prim which recreates the path at every call and give a different hash
-    ImGuiContext &g = *GImGui;
-    ImGuiWindow *window = g.CurrentWindow;
-    ImGuiStorage *storage = window->DC.StateStorage;
-    for (auto iter = range.begin(); iter != range.end(); ++iter) {
+// Append the rows of the prims in [iter, end) skipping the children of the paths closed by the tree ui.
+void StageOutlinerRows::_TraverseRange(UsdPrimRange::iterator iter, const UsdPrimRange::iterator &end, ImGuiStorage *storage,
+                                       std::vector<Row> &rows) {
+    for (; iter != end; ++iter) {
         const auto &path = iter->GetPath();
         const ImGuiID pathHash = IdOf(GetHash(path));
         const bool isOpen = storage->GetInt(pathHash, 0) != 0;
         if (!isOpen) {
             iter.PruneChildren();
+        } else if (iter->IsInstanceProxy()) {
+            _instanceProxyPaths.Retain(path);
         }
-        // This bit of code is to avoid a bug. It appears that the SdfPath of instance proxies are not kept and the underlying memory
-        // is deleted and recreated between each frame, invalidating the hash value. So for the same path we have different hash every frame :s not cool.
-        // This problems appears on versions > 21.11
-        // a look at the changelog shows that they were lots of changes on the SdfPath side:
-        // https://github.com/PixarAnimationStudios/USD/commit/46c26f63d2a6e9c6c5dbfbcefa0235c3265457bb
-        //
-        // In the end we workaround this issue by keeping the instance proxy paths alive:
-        if (iter->IsInstanceProxy()) {
-            retainedPath.insert(path);
-        }
-        paths.push_back(path);
+        rows.push_back({path, iter->GetFilteredChildren(_predicate).empty()});
     }
 }
 
-// Traverse the stage skipping the paths closed by the tree ui.
-static void TraverseOpenedPaths(UsdStageRefPtr stage, std::vector<SdfPath> &paths, StageOutlinerDisplayOptions &displayOptions) {
-    if (!stage)
-        return;
+void StageOutlinerRows::Update(const UsdStageRefPtr &stage, const StageOutlinerDisplayOptions &displayOptions) {
+    _instanceProxyPaths.ReleaseClosedStages();
+    if (get_pointer(stage) != get_pointer(_stage) || !(displayOptions.GetPrimFlagsPredicate() == _predicate) ||
+        displayOptions.GetShowPrototypes() != _showPrototypes) {
+        _stage = stage;
+        _predicate = displayOptions.GetPrimFlagsPredicate();
+        _showPrototypes = displayOptions.GetShowPrototypes();
+        _needsRebuild = true;
+        _instanceProxyPaths.SetStage(stage);
+    }
+    // The root prims and the prototypes are not under a row, they are traversed again with the whole stage
+    for (const SdfPath &path : _resyncedPaths) {
+        if (path.IsAbsoluteRootPath() || path.GetParentPath().IsAbsoluteRootPath() || UsdPrim::IsPathInPrototype(path)) {
+            _needsRebuild = true;
+            break;
+        }
+    }
     ImGuiContext &g = *GImGui;
     ImGuiWindow *window = g.CurrentWindow;
     ImGuiStorage *storage = window->DC.StateStorage;
-    paths.clear();
-    const SdfPath &rootPath = SdfPath::AbsoluteRootPath();
-    const bool rootPathIsOpen = storage->GetInt(IdOf(GetHash(rootPath)), 0) != 0;
-
-    if (rootPathIsOpen) {
-        // Stage
-        auto range = UsdPrimRange::Stage(stage, displayOptions.GetPrimFlagsPredicate());
-        TraverseRange(range, paths);
-        // Prototypes
-        if (displayOptions.GetShowPrototypes()) {
-            for(const auto &proto: stage->GetPrototypes()) {
-                auto range = UsdPrimRange(proto, displayOptions.GetPrimFlagsPredicate());
-                TraverseRange(range, paths);
+    if (_needsRebuild) {
+        _rows.clear();
+        _rowIndex.Invalidate();
+        const bool rootPathIsOpen = storage->GetInt(IdOf(GetHash(SdfPath::AbsoluteRootPath())), 0) != 0;
+        if (stage && rootPathIsOpen) {
+            // Stage
+            auto range = UsdPrimRange::Stage(stage, _predicate);
+            _TraverseRange(range.begin(), range.end(), storage, _rows);
+            // Prototypes
+            if (_showPrototypes) {
+                for (const auto &proto : stage->GetPrototypes()) {
+                    auto range = UsdPrimRange(proto, _predicate);
+                    _TraverseRange(range.begin(), range.end(), storage, _rows);
+                }
             }
         }
+    } else {
+        // A resync replaces the children of the parent, the resynced prim might be new or removed
+        SdfPathVector subtreePaths(_toggledPaths);
+        for (const SdfPath &path : _resyncedPaths) {
+            subtreePaths.push_back(path.GetParentPath());
+        }
+        _UpdateSubtrees(subtreePaths, storage);
+    }
+    SdfPathVector releasedPaths;
+    if (_needsRebuild || !_resyncedPaths.empty() || !_toggledPaths.empty()) {
+        _instanceProxyPaths.EndTraversal(
+            storage, [this](const SdfPath &path) { return FindRow(path) >= 0; }, releasedPaths);
+    }
+    _needsRebuild = false;
+    _resyncedPaths.clear();
+    // The released tree nodes were closed, their subtrees are traversed again in the next update if they are shown
+    _toggledPaths = std::move(releasedPaths);
+}
+
+// Traverse again the children of the rows of the paths, when they are visible. The paths inside another subtree are
+// skipped, the rows are copied once to a new vector with the new children of each subtree and the index is rebuilt once
+void StageOutlinerRows::_UpdateSubtrees(SdfPathVector &paths, ImGuiStorage *storage) {
+    SdfPath::RemoveDescendentPaths(&paths);
+    std::vector<std::pair<int, SdfPath>> subtrees;
+    for (const SdfPath &path : paths) {
+        const int rowIndex = FindRow(path);
+        if (rowIndex >= 0) {
+            subtrees.emplace_back(rowIndex, path);
+        }
+    }
+    if (subtrees.empty()) {
+        return;
+    }
+    std::sort(subtrees.begin(), subtrees.end(),
+              [](const std::pair<int, SdfPath> &a, const std::pair<int, SdfPath> &b) { return a.first < b.first; });
+    std::vector<Row> rows;
+    rows.reserve(_rows.size());
+    size_t nextRow = 0;
+    for (const auto &subtree : subtrees) {
+        const SdfPath &path = subtree.second;
+        rows.insert(rows.end(), _rows.begin() + nextRow, _rows.begin() + subtree.first + 1);
+        // Skip the previous children
+        nextRow = subtree.first + 1;
+        while (nextRow < _rows.size() && _rows[nextRow].path.HasPrefix(path)) {
+            ++nextRow;
+        }
+        const UsdPrim prim = _stage->GetPrimAtPath(path);
+        if (!prim) {
+            continue;
+        }
+        rows.back().isLeaf = prim.GetFilteredChildren(_predicate).empty();
+        if (storage->GetInt(IdOf(GetHash(path)), 0) != 0) {
+            auto range = UsdPrimRange(prim, _predicate);
+            auto firstChild = range.begin();
+            ++firstChild; // skip the prim itself
+            _TraverseRange(firstChild, range.end(), storage, rows);
+        }
     }
+    rows.insert(rows.end(), _rows.begin() + nextRow, _rows.end());
+    _rows.swap(rows);
+    _rowIndex.Invalidate();
+}
+
+int StageOutlinerRows::FindRow(const SdfPath &path) {
+    return _rowIndex.Find(path, _rows, [](const Row &row) -> const SdfPath & { return row.path; });
+}
+
+static void ScrollToRow(int row, ImGuiListClipper &clipper) {
+    // scroll only if the item is not visible
+    if (row < clipper.DisplayStart || row > clipper.DisplayEnd) {
+        ImGui::SetScrollY(clipper.ItemsHeight * row + 1);
+    }
+}
+
+static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, StageOutlinerRows &rows, ImGuiListClipper &clipper) {
+    const int row = rows.FindRow(selectedPath);
+    if (row >= 0) {
+        ScrollToRow(row, clipper);
+    }
+}
+
+// The filtered paths are sorted
+static int FindFilteredRow(const SdfPath &path, const SdfPathVector &filteredPaths) {
+    const auto found = std::lower_bound(filteredPaths.begin(), filteredPaths.end(), path);
+    return found != filteredPaths.end() && *found == path ? static_cast<int>(found - filteredPaths.begin()) : -1;
 }
 
-static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const std::vector<SdfPath> &paths,
+static void FocusedOnFirstSelectedPath(const SdfPath &selectedPath, const SdfPathVector &filteredPaths,
                                        ImGuiListClipper &clipper) {
-    // linear search! it happens only when the selection has changed. We might want to maintain a map instead
-    // if the hierarchies are big.
-    for (int i = 0; i < paths.size(); ++i) {
-        if (paths[i] == selectedPath) {
-            // scroll only if the item is not visible
-            if (i < clipper.DisplayStart || i > clipper.DisplayEnd) {
-                ImGui::SetScrollY(clipper.ItemsHeight * i + 1);
-            }
-            return;
+    const int row = FindFilteredRow(selectedPath, filteredPaths);
+    if (row >= 0) {
+        ScrollToRow(row, clipper);
+    }
+}
+
+// Returns -1 or 1 when the up or down arrow is pressed while the outliner is focused and not editing a field
+static int GetArrowKeyStep() {
+    if (!ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) || ImGui::IsAnyItemActive()) {
+        return 0;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) {
+        return -1;
+    } else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) {
+        return 1;
+    }
+    return 0;
+}
+
+// Returns the closest selected row after (step 1) or before (step -1) fromRow, wrapping around at the ends,
+// or -1 when none of the selected paths are shown
+static int FindNextSelectedRow(const SdfPathVector &selectedPaths, const std::function<int(const SdfPath &)> &findRow,
+                               int fromRow, int step) {
+    int next = -1;
+    int wrapped = -1;
+    for (const SdfPath &path : selectedPaths) {
+        const int row = findRow(path);
+        if (row < 0) {
+            continue;
+        }
+        if ((row - fromRow) * step > 0 && (next < 0 || (row - next) * step < 0)) {
+            next = row;
+        }
+        if (wrapped < 0 || (row - wrapped) * step < 0) {
+            wrapped = row;
+        }
+    }
+    return next >= 0 ? next : wrapped;
+}
+
+// Up and down select the previous and next rows, with control they scroll to the previous and next selected rows
+// without changing the selection. focusedSelectedRow is the last selected row scrolled to, each view keeps its own
+static void NavigateRowsWithKeyboard(const UsdStageRefPtr &stage, const Selection &selectedPaths, int rowCount,
+                                     const std::function<int(const SdfPath &)> &findRow,
+                                     const std::function<const SdfPath &(int)> &pathOfRow, ImGuiListClipper &clipper,
+                                     int &focusedSelectedRow) {
+    const int step = GetArrowKeyStep();
+    if (step == 0 || rowCount == 0) {
+        return;
+    }
+    const int anchorRow = findRow(selectedPaths.GetAnchorPrimPath(stage));
+    if (ImGui::GetIO().KeyCtrl) {
+        const int fromRow = focusedSelectedRow >= 0 && focusedSelectedRow < rowCount ? focusedSelectedRow : anchorRow;
+        const int row = FindNextSelectedRow(selectedPaths.GetSelectedPaths(stage), findRow, fromRow, step);
+        if (row >= 0) {
+            focusedSelectedRow = row;
+            ScrollToRow(row, clipper);
+        }
+    } else {
+        const int row = anchorRow < 0 ? 0 : std::max(0, std::min(anchorRow + step, rowCount - 1));
+        if (row != anchorRow) {
+            focusedSelectedRow = -1;
+            ExecuteAfterDraw<EditorSetSelection>(stage, pathOfRow(row));
         }
     }
 }
@@ -413,12 +995,75 @@ void DrawStageOutlinerMenuBar(StageOutlinerDisplayOptions &displayOptions) {
 }
 
 /// Draw the hierarchy of the stage
-void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
+/// Results of the find all search
+static void DrawPrimSearchResults(const UsdStageRefPtr &stage, Selection &selectedPaths, PrimSearch &primSearch) {
+    const SdfPathVector &results = primSearch.GetResults();
+    if (primSearch.IsRunning()) {
+        ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), ImVec2(ImGui::GetFontSize() * 8, 0.f), "Searching");
+        ImGui::SameLine();
+        ImGui::Text("%zu found", results.size());
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            primSearch.Cancel();
+        }
+    } else {
+        ImGui::Text("%zu found", results.size());
+        ImGui::SameLine();
+        if (ImGui::Button("Select results")) {
+            ExecuteAfterDraw<EditorSelectPaths>(stage, results);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Close")) {
+            primSearch.Clear();
+        }
+    }
+    if (!primSearch.GetErrorMessage().empty()) {
+        ImGui::TextColored(ImVec4(1.0, 0.2, 0.2, 1.0), "%s", primSearch.GetErrorMessage().c_str());
+    }
+    if (ImGui::BeginChild("##PrimSearchResults")) {
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(results.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                ImGui::PushID(row);
+                const SdfPath &path = results[row];
+                if (ImGui::Selectable(path.GetText(), selectedPaths.IsSelected(stage, path))) {
+                    ExecuteAfterDraw<EditorSetSelection>(stage, path);
+                }
+                ImGui::PopID();
+            }
+        }
+    }
+    ImGui::EndChild();
+}
+
+// The rows live until the application closes, like the command stack
+static StageOutlinerRows &GetStageOutlinerRows() {
+    static StageOutlinerRows *outlinerRows = new StageOutlinerRows();
+    return *outlinerRows;
+}
+
+int GetStageOutlinerRow(const SdfPath &primPath) { return GetStageOutlinerRows().FindRow(primPath); }
+
+void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths, PrimSearch &primSearch, PrimSearch &primFilter) {
     if (!stage)
         return;
     
     static StageOutlinerDisplayOptions displayOptions;
+    StageOutlinerRows *outlinerRows = &GetStageOutlinerRows();
+    static StageOutlinerFilter outlinerFilter;
+    static PrimRowInfoCache *rowInfoCache = new PrimRowInfoCache();
+    rowInfoCache->SetStage(stage);
     DrawStageOutlinerMenuBar(displayOptions);
+
+    // The filtered view replaces the tree once the filter has found its first results
+    outlinerFilter.Draw();
+    outlinerFilter.Update(stage, displayOptions.GetPrimFlagsPredicate(), primFilter);
+    const bool showFilteredPaths = outlinerFilter.IsActive();
+    if (showFilteredPaths && primFilter.IsRunning()) {
+        ImGui::SameLine();
+        ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), ImVec2(ImGui::GetFontSize() * 4, 0.f), "");
+    }
     
     //ImGui::PushID("StageOutliner");
     constexpr unsigned int textBufferSize = 512;
@@ -430,7 +1075,9 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
     static SelectionHash lastSelectionHash = 0;
 
     const ImGuiContext &g = *GImGui;
-    const ImVec2 tableOuterSize(0, RemainingHeight(2));
+    // The find all results take the bottom of the window
+    const bool showSearchResults = primSearch.IsRunning() || !primSearch.GetResults().empty() || !primSearch.GetErrorMessage().empty();
+    const ImVec2 tableOuterSize(0, RemainingHeight(showSearchResults ? 12 : 2));
     constexpr ImGuiTableFlags tableFlags = ImGuiTableFlags_SizingFixedFit | /*ImGuiTableFlags_RowBg |*/ ImGuiTableFlags_ScrollY;
     if (ImGui::BeginTable("##DrawStageOutliner", 3, tableFlags, tableOuterSize)) {
         ImGui::TableSetupScrollFreeze(3, 1); // Freeze the root node of the tree (the layer)
@@ -442,47 +1089,96 @@ void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths) {
         // Unfold the selected path
         const bool selectionHasChanged = selectedPaths.UpdateSelectionHash(stage, lastSelectionHash);
         if (selectionHasChanged) {            // We could use the imgui id as well instead of a static ??
-            OpenSelectedPaths(stage, selectedPaths); // Also we could have a UsdTweakFrame which contains all the changes that happened
+            OpenSelectedPaths(stage, selectedPaths, *outlinerRows); // Also we could have a UsdTweakFrame which contains all the changes that happened
                                               // between the last frame and the new one
         }
 
-        // Find all the opened paths
-        std::vector<SdfPath> paths;
-        paths.reserve(1024);
-        TraverseOpenedPaths(stage, paths, displayOptions); // This must be inside the table scope to get the correct treenode hash table
+        // Update the opened paths
+        outlinerRows->Update(stage, displayOptions); // This must be inside the table scope to get the correct treenode hash table
+        const std::vector<StageOutlinerRows::Row> &rows = outlinerRows->GetRows();
 
         // Draw the tree root node, the layer
-        DrawStageTreeRow(stage, selectedPaths);
+        DrawStageTreeRow(stage, selectedPaths, *outlinerRows);
 
-        // Display only the visible paths with a clipper
-        ImGuiListClipper clipper;
-        clipper.Begin(static_cast<int>(paths.size()));
-        while (clipper.Step()) {
-            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
-                ImGui::PushID(row);
-                const SdfPath &path = paths[row];
-                const auto &prim = stage->GetPrimAtPath(path);
-                DrawPrimTreeRow(prim, selectedPaths, displayOptions);
-                ImGui::PopID();
+        if (showFilteredPaths) {
+            // The matching prims and their ancestors are all shown, without tree nodes to open
+            const SdfPathVector &filteredPaths = primFilter.GetResults();
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(filteredPaths.size()));
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    ImGui::PushID(row);
+                    const auto &prim = stage->GetPrimAtPath(filteredPaths[row]);
+                    if (prim) {
+                        DrawPrimTreeRow(prim, true, rowInfoCache->Get(prim), selectedPaths, *outlinerRows,
+                                        !primFilter.IsMatching(filteredPaths[row]));
+                    } else {
+                        // The prim was removed, the filter runs again
+                        ImGui::TableNextRow();
+                    }
+                    ImGui::PopID();
+                }
             }
-        }
-        if (selectionHasChanged) {
-            // This function can only be called in this context and after the clipper.Step()
-            FocusedOnFirstSelectedPath(selectedPaths.GetAnchorPrimPath(stage), paths, clipper);
+            if (selectionHasChanged) {
+                FocusedOnFirstSelectedPath(selectedPaths.GetAnchorPrimPath(stage), filteredPaths, clipper);
+            }
+            static int focusedFilteredRow = -1;
+            NavigateRowsWithKeyboard(
+                stage, selectedPaths, static_cast<int>(filteredPaths.size()),
+                [&filteredPaths](const SdfPath &path) { return FindFilteredRow(path, filteredPaths); },
+                [&filteredPaths](int row) -> const SdfPath & { return filteredPaths[row]; }, clipper, focusedFilteredRow);
+        } else {
+            // Display only the visible paths with a clipper
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(rows.size()));
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    ImGui::PushID(row);
+                    const auto &prim = stage->GetPrimAtPath(rows[row].path);
+                    if (prim) {
+                        DrawPrimTreeRow(prim, rows[row].isLeaf, rowInfoCache->Get(prim), selectedPaths, *outlinerRows);
+                    } else {
+                        // The prim was removed during the frame, its row is updated at the next frame
+                        ImGui::TableNextRow();
+                    }
+                    ImGui::PopID();
+                }
+            }
+            if (selectionHasChanged) {
+                // This function can only be called in this context and after the clipper.Step()
+                FocusedOnFirstSelectedPath(selectedPaths.GetAnchorPrimPath(stage), *outlinerRows, clipper);
+            }
+            static int focusedRow = -1;
+            NavigateRowsWithKeyboard(
+                stage, selectedPaths, static_cast<int>(rows.size()),
+                [outlinerRows](const SdfPath &path) { return outlinerRows->FindRow(path); },
+                [&rows](int row) -> const SdfPath & { return rows[row].path; }, clipper, focusedRow);
         }
         ImGui::EndTable();
     }
 
     // Search prim bar
     static char patternBuffer[256];
-    static bool useRegex = false;
-    ImGui::SetNextItemWidth(ImGui::GetCurrentWindow()->Size[0]-g.FontSize * 12);
+    static int nameMatch = static_cast<int>(PrimNameMatch::Exact);
+    ImGui::SetNextItemWidth(ImGui::GetCurrentWindow()->Size[0]-g.FontSize * 25);
     auto enterPressed = ImGui::InputTextWithHint("##SearchPrims", "Find prim", patternBuffer, 256, ImGuiInputTextFlags_EnterReturnsTrue);
     ImGui::SameLine();
-    ImGui::Checkbox("use regex", &useRegex);
+    ImGui::SetNextItemWidth(g.FontSize * 6);
+    ImGui::Combo("##NameMatch", &nameMatch, "Exact\0Wildcards\0Regex\0");
     ImGui::SameLine();
     if (ImGui::Button("Select next") || enterPressed) {
-        ExecuteAfterDraw<EditorFindPrim>(std::string(patternBuffer), useRegex);
+        ExecuteAfterDraw<EditorFindPrim>(std::string(patternBuffer), static_cast<PrimNameMatch>(nameMatch));
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Select all")) {
+        ExecuteAfterDraw<EditorFindPrim>(std::string(patternBuffer), static_cast<PrimNameMatch>(nameMatch), true);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Find all")) {
+        primSearch.Start(stage, std::string(patternBuffer), static_cast<PrimNameMatch>(nameMatch));
+    }
+    if (showSearchResults) {
+        DrawPrimSearchResults(stage, selectedPaths, primSearch);
     }
 
 }
@@ -1,8 +1,12 @@
 #pragma once
 #include <pxr/usd/usd/stage.h>
 #include "Selection.h" // TODO: ideally we should have only pxr headers here
+#include "PrimSearch.h"
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
 // TODO: selected could be multiple Path, we should pass a HdSelection instead
-void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths);
+void DrawStageOutliner(UsdStageRefPtr stage, Selection &selectedPaths, PrimSearch &primSearch, PrimSearch &primFilter);
+
+/// Returns the row of the prim in the stage outliner, or -1 when it is not shown
+int GetStageOutlinerRow(const SdfPath &primPath);
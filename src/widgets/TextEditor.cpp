@@ -1,40 +1,340 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/notice.h>
 #include "TextEditor.h"
 #include "Commands.h"
 #include "Gui.h"
 #include "ImGuiHelpers.h"
+#include "LayerTextDiff.h"
 
 // The following include contains the code which writes usd to text, but it's not
 // distributed with the api
 //#include <pxr/usd/sdf/fileIO_Common.h>
 
-void DrawTextEditor(SdfLayerRefPtr layer) {
-    static std::string layerText;
+// Characters drawn on a line, the arrays of big layers are often written on a single line
+static constexpr size_t MaxDisplayedLineLength = 1024;
+
+// A layer edited continuously is exported at most at this interval, the copy of the layer holds the stage mutex
+static constexpr double MinExportInterval = 0.5;
+
+///
+/// LayerText is the exported text of a layer, indexed by line, with the lines of each prim definition.
+/// It is immutable once created and shared between the worker thread and the editor.
+///
+struct LayerText {
+    // Lines of a prim definition, its children included
+    struct PrimLines {
+        SdfPath path;
+        size_t begin;
+        size_t end;
+        int parent;
+    };
+
+    LayerText(std::string exportedText) : text(std::move(exportedText)) {
+        lineStarts.push_back(0);
+        for (size_t pos = text.find('\n'); pos != std::string::npos && pos + 1 < text.size(); pos = text.find('\n', pos + 1)) {
+            lineStarts.push_back(pos + 1);
+        }
+        for (const UsdaPrimBlock &block : FindUsdaPrimBlocks(text)) {
+            prims.push_back({block.path, GetLine(block.begin), GetLine(block.end - 1) + 1, block.parent});
+        }
+        headerEnd = GetLineCount();
+        for (const PrimLines &prim : prims) {
+            if (prim.parent < 0) {
+                headerEnd = prim.begin;
+                break;
+            }
+        }
+    }
+
+    size_t GetLineCount() const { return lineStarts.size(); }
+    size_t GetLineBegin(size_t line) const { return lineStarts[line]; }
+    size_t GetLineEnd(size_t line) const { return line + 1 < lineStarts.size() ? lineStarts[line + 1] : text.size(); }
+
+    size_t GetLine(size_t offset) const {
+        return std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin() - 1;
+    }
+
+    // Returns the innermost prim defined on the line, or -1 if the line is not part of a prim definition
+    int FindPrim(size_t line) const {
+        auto found = std::upper_bound(prims.begin(), prims.end(), line,
+                                      [](size_t line, const PrimLines &prim) { return line < prim.begin; });
+        int primIndex = static_cast<int>(found - prims.begin()) - 1;
+        while (primIndex >= 0 && prims[primIndex].end <= line) {
+            primIndex = prims[primIndex].parent;
+        }
+        return primIndex;
+    }
+
+    std::string GetText(size_t beginLine, size_t endLine) const {
+        const size_t begin = GetLineBegin(beginLine);
+        return text.substr(begin, GetLineEnd(endLine - 1) - begin);
+    }
+
+    std::string text;
+    std::vector<size_t> lineStarts;
+    std::vector<PrimLines> prims; // in the order of the text
+    size_t headerEnd = 0;         // first line following the layer header
+};
+
+///
+/// LayerTextCache keeps the text of the layer shown in the editor. The text is exported again only when the
+/// layer changes. The export runs on a worker thread on a snapshot of the layer, so the layer can still be
+/// edited on the main thread while it is written. The worker copies the layer to the snapshot while holding the
+/// stage mutex, like the searches read the layers. The snapshot is not taken while the text is edited or while an
+/// edition spanning multiple frames is recorded, and at most once per MinExportInterval.
+///
+class LayerTextCache : public TfWeakBase {
+  public:
+    LayerTextCache() {
+        _noticeKey = TfNotice::Register(TfCreateWeakPtr(this), &LayerTextCache::OnLayersDidChange);
+    }
+
+    ~LayerTextCache() { TfNotice::Revoke(_noticeKey); }
+
+    /// Start a new export if the layer changed and retrieve the exported text when it's ready.
+    /// The text is not replaced while it is edited
+    void Update(const SdfLayerRefPtr &layer, bool isEditing, std::mutex &stageMutex) {
+        if (get_pointer(layer) != get_pointer(_layer)) {
+            _layer = layer;
+            _text.reset();
+            _isDirty = true;
+            _exportStartTime = 0.0; // a new layer is exported without waiting
+        }
+        if (_export.valid() && !isEditing &&
+            _export.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            std::shared_ptr<const LayerText> text = _export.get();
+            // The current layer might have changed during the export
+            if (_exportedLayer == _layer) {
+                _text = text;
+            }
+        }
+        if (_isDirty && !_export.valid() && _layer && !isEditing && !IsEditionActive() &&
+            ImGui::GetTime() - _exportStartTime > MinExportInterval) {
+            _isDirty = false;
+            _exportStartTime = ImGui::GetTime();
+            _exportedLayer = _layer;
+            SdfLayerRefPtr exportedLayer(_layer);
+            std::mutex *mutex = &stageMutex;
+            _export = std::async(std::launch::async, [exportedLayer, mutex]() mutable {
+                SdfLayerRefPtr snapshot = SdfLayer::CreateAnonymous(".usda");
+                {
+                    std::lock_guard<std::mutex> lock(*mutex);
+                    snapshot->TransferContent(exportedLayer);
+                    exportedLayer = SdfLayerRefPtr(); // the layer might be closed meanwhile, it is released locked
+                }
+                std::string text;
+                snapshot->ExportToString(&text);
+                snapshot = SdfLayerRefPtr(); // released on the worker, it can take a while
+                return std::shared_ptr<const LayerText>(new LayerText(std::move(text)));
+            });
+        }
+    }
+
+    /// The text shown is older than the layer
+    bool IsExporting() const { return _isDirty || _export.valid(); }
+    double GetExportDuration() const { return ImGui::GetTime() - _exportStartTime; }
+
+    /// Returns nullptr until the first export of the layer is finished
+    const LayerText *GetText() const { return _text.get(); }
+
+    void OnLayersDidChange(const SdfNotice::LayersDidChange &notice) {
+        for (const auto &layerChanges : notice.GetChangeListVec()) {
+            if (layerChanges.first == _layer) {
+                _isDirty = true;
+            }
+        }
+    }
+
+  private:
+    SdfLayerHandle _layer;
+    SdfLayerHandle _exportedLayer;
+    std::future<std::shared_ptr<const LayerText>> _export;
+    std::shared_ptr<const LayerText> _text;
+    bool _isDirty = true;
+    double _exportStartTime = 0.0;
+    TfNotice::Key _noticeKey;
+};
+
+///
+/// Lines of the layer text being edited. It's either a prim definition, the layer header when the path is the
+/// pseudo root, or the whole text when the path is empty.
+///
+struct TextEditorRegion {
+    bool isActive = false;
+    SdfPath primPath;
+    size_t beginLine = 0;
+    size_t endLine = 0;
+    std::string text;
+};
+
+static void StartEditingRegion(TextEditorRegion &region, const LayerText &layerText, const SdfPath &primPath, size_t beginLine,
+                               size_t endLine) {
+    region.isActive = beginLine < endLine;
+    region.primPath = primPath;
+    region.beginLine = beginLine;
+    region.endLine = endLine;
+    region.text = region.isActive ? layerText.GetText(beginLine, endLine) : std::string();
+}
+
+static void StopEditingRegion(TextEditorRegion &region) {
+    region.isActive = false;
+    std::string().swap(region.text);
+}
+
+// Draw the read only lines in [beginLine, endLine), only the visible ones are submitted to ImGui
+static void DrawTextLines(const LayerText &layerText, size_t beginLine, size_t endLine, size_t &selectedLine,
+                          bool &startEditing) {
+    const int lineNumberWidth = static_cast<int>(std::to_string(layerText.GetLineCount()).size());
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(endLine - beginLine));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const size_t line = beginLine + i;
+            if (line == selectedLine) {
+                const ImVec2 cursor = ImGui::GetCursorScreenPos();
+                ImGui::GetWindowDrawList()->AddRectFilled(
+                    cursor, ImVec2(cursor.x + ImGui::GetContentRegionAvail().x, cursor.y + ImGui::GetTextLineHeight()),
+                    ImGui::GetColorU32(ImGuiCol_Header));
+            }
+            ImGui::TextDisabled("%*zu", lineNumberWidth, line + 1);
+            ImGui::SameLine();
+            const char *lineBegin = layerText.text.data() + layerText.GetLineBegin(line);
+            size_t lineLength = layerText.GetLineEnd(line) - layerText.GetLineBegin(line);
+            if (lineLength && lineBegin[lineLength - 1] == '\n') {
+                lineLength--;
+            }
+            ImGui::TextUnformatted(lineBegin, lineBegin + std::min(lineLength, MaxDisplayedLineLength));
+            if (ImGui::IsItemClicked()) {
+                selectedLine = line;
+                startEditing = ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left);
+            }
+            if (lineLength > MaxDisplayedLineLength) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("... %zu more characters", lineLength - MaxDisplayedLineLength);
+            }
+        }
+    }
+}
+
+void DrawTextEditor(SdfLayerRefPtr layer, std::mutex &stageMutex) {
+    // The cache lives until the application closes, like the command stack
+    static LayerTextCache *layerTextCache = new LayerTextCache();
+    static TextEditorRegion region;
+    static size_t selectedLine = static_cast<size_t>(-1);
+    static SdfLayerHandle lastLayer;
     ImGuiIO &io = ImGui::GetIO();
     ImGuiWindow *window = ImGui::GetCurrentWindow();
     if (window->SkipItems) {
         return;
     }
-    ImGui::Text("WARNING: this will slow down the application if the layer is big");
-    ImGui::Text("        and will consume lots of memory. Use with care for now");
+    if (get_pointer(layer) != get_pointer(lastLayer)) {
+        lastLayer = layer;
+        selectedLine = static_cast<size_t>(-1);
+        StopEditingRegion(region);
+    }
+    layerTextCache->Update(layer, region.isActive, stageMutex);
     if (layer) {
-        layer->ExportToString(&layerText);
         ImGui::Text("Editing: %s", layer->GetDisplayName().c_str());
     } else {
         ImGui::Text("No layer loader");
     }
-    ImGui::Text("Ctrl+Enter to apply your change");
-    ImGui::PushItemWidth(-FLT_MIN);
-    ImGuiWindow *currentWindow = ImGui::GetCurrentWindow();
-    ImVec2 sizeArg(0, -1);
+    const LayerText *layerText = layerTextCache->GetText();
+    // The text can't be edited while a new version is exported, the edit would revert the last layer changes
+    const bool isExporting = layer && layerTextCache->IsExporting();
+    if (isExporting) {
+        ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), ImVec2(ImGui::GetContentRegionAvail().x * 0.5f, 0.f),
+                           "Exporting");
+        ImGui::SameLine();
+        ImGui::Text("%.1fs", layerTextCache->GetExportDuration());
+    }
+    if (!layerText) {
+        return;
+    }
+
+    // Toolbar
+    bool applyRegion = false;
+    bool startEditing = false;
+    const int selectedPrim = selectedLine < layerText->GetLineCount() ? layerText->FindPrim(selectedLine) : -1;
+    const bool selectedHeader = selectedLine < layerText->headerEnd;
+    if (region.isActive) {
+        ImGui::Text("Editing %s", region.primPath.IsEmpty()                         ? "the whole layer"
+                                  : region.primPath == SdfPath::AbsoluteRootPath() ? "the layer header"
+                                                                                   : region.primPath.GetText());
+        ImGui::SameLine();
+        // The editing starts on an up to date text, an export means the layer changed since and the edit would revert it
+        ImGui::BeginDisabled(isExporting);
+        applyRegion = ImGui::Button("Apply");
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip(isExporting ? "The layer changed since the edit started, cancel to edit the new version"
+                                          : "Ctrl+Enter to apply your change");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            StopEditingRegion(region);
+        }
+    } else {
+        ImGui::BeginDisabled(isExporting || (selectedPrim < 0 && !selectedHeader));
+        startEditing = ImGui::Button("Edit selection");
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Edit the prim defined on the selected line, or double click on a line");
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(isExporting);
+        if (ImGui::Button("Edit whole layer")) {
+            StartEditingRegion(region, *layerText, SdfPath(), 0, layerText->GetLineCount());
+        }
+        ImGui::EndDisabled();
+        if (selectedPrim >= 0) {
+            ImGui::SameLine();
+            ImGui::Text("Line %zu: %s", selectedLine + 1, layerText->prims[selectedPrim].path.GetText());
+        }
+    }
+
+    // Text, the lines before and after the edited region are drawn read only
     ImGui::PushFont(io.Fonts->Fonts[1]);
-    {
-        ScopedStyleColor color(ImGuiCol_FrameBg, ImVec4{0.0, 0.0, 0.0, 1.0});
-        ImGui::InputTextMultiline("###TextEditor", &layerText, sizeArg,
-                                  ImGuiInputTextFlags_None | ImGuiInputTextFlags_NoUndoRedo);
-        if (layer && ImGui::IsItemDeactivatedAfterEdit()) {
-            ExecuteAfterDraw<LayerTextEdit>(layer, layerText);
+    ScopedStyleColor color(ImGuiCol_ChildBg, ImVec4{0.0, 0.0, 0.0, 1.0}, ImGuiCol_FrameBg, ImVec4{0.0, 0.0, 0.0, 1.0});
+    if (ImGui::BeginChild("##TextEditorLines", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar)) {
+        if (region.isActive) {
+            DrawTextLines(*layerText, 0, region.beginLine, selectedLine, startEditing);
+            const size_t regionLines = std::min<size_t>(region.endLine - region.beginLine, 40);
+            const float height = regionLines * ImGui::GetTextLineHeight() + ImGui::GetStyle().FramePadding.y * 2.f;
+            ImGui::InputTextMultiline("###TextEditorRegion", &region.text, ImVec2(-FLT_MIN, height),
+                                      ImGuiInputTextFlags_NoUndoRedo);
+            applyRegion |= ImGui::IsItemActive() && io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Enter, false);
+            DrawTextLines(*layerText, region.endLine, layerText->GetLineCount(), selectedLine, startEditing);
+            // Another line can't be edited before the region is applied or cancelled
+            startEditing = false;
+        } else {
+            DrawTextLines(*layerText, 0, layerText->GetLineCount(), selectedLine, startEditing);
         }
     }
+    ImGui::EndChild();
     ImGui::PopFont();
-    ImGui::PopItemWidth();
+
+    if (applyRegion && region.isActive && layer && !isExporting) {
+        if (region.text == layerText->GetText(region.beginLine, region.endLine)) {
+            // Nothing changed
+        } else if (region.primPath.IsEmpty()) {
+            ExecuteAfterDraw<LayerTextEdit>(layer, region.text);
+        } else {
+            ExecuteAfterDraw<LayerTextEdit>(layer, region.primPath, region.text);
+        }
+        StopEditingRegion(region);
+    } else if (startEditing && !isExporting && selectedLine < layerText->GetLineCount()) {
+        const int prim = layerText->FindPrim(selectedLine);
+        if (prim >= 0) {
+            const LayerText::PrimLines &lines = layerText->prims[prim];
+            StartEditingRegion(region, *layerText, lines.path, lines.begin, lines.end);
+        } else if (selectedLine < layerText->headerEnd) {
+            StartEditingRegion(region, *layerText, SdfPath::AbsoluteRootPath(), 0, layerText->headerEnd);
+        }
+    }
 }
@@ -1,7 +1,9 @@
 #pragma once
+#include <mutex>
 
 #include <pxr/usd/sdf/layer.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
 
-void DrawTextEditor(SdfLayerRefPtr layer);
+/// Draw the text of the layer, it is exported on a worker thread which locks stageMutex while it reads the layer
+void DrawTextEditor(SdfLayerRefPtr layer, std::mutex &stageMutex);